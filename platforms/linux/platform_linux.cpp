@@ -0,0 +1,22 @@
+#include "platform.hpp"
+#include <unistd.h>
+#include <sys/resource.h>
+#include <stdexcept>
+
+// returns the full path to the file `fileName` in the directory of the executable
+std::string ResourcePath(std::string fileName) {
+    char executablePath[1024] = {'\0'};
+    ssize_t charsCopied = readlink("/proc/self/exe", executablePath, sizeof(executablePath) - 1);
+    if(charsCopied <= 0 || charsCopied >= (ssize_t)sizeof(executablePath) - 1)
+        throw std::runtime_error("readlink of /proc/self/exe failed");
+
+    std::string path(executablePath, (size_t)charsCopied);
+    return path.substr(0, path.find_last_of('/') + 1) + fileName;
+}
+
+size_t PeakMemoryUsage() {
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (size_t)usage.ru_maxrss * 1024; // kilobytes on Linux
+}
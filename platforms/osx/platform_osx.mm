@@ -6,6 +6,7 @@
 
 #import "platform.hpp"
 #import <Foundation/Foundation.h>
+#include <sys/resource.h>
 
 // returns the full path to the file `fileName` in the resources directory of the app bundle
 std::string ResourcePath(std::string fileName) {
@@ -13,3 +14,10 @@ std::string ResourcePath(std::string fileName) {
     NSString* path = [[[NSBundle mainBundle] resourcePath] stringByAppendingPathComponent:fname];
     return std::string([path cStringUsingEncoding:NSUTF8StringEncoding]);
 }
+
+size_t PeakMemoryUsage() {
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (size_t)usage.ru_maxrss; // bytes on OS X
+}
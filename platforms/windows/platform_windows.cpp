@@ -1,5 +1,6 @@
 #include "platform.hpp"
 #include <windows.h>
+#include <psapi.h>
 #include <stdexcept>
 
 std::string ResourcePath(std::string fileName) {
@@ -11,3 +12,9 @@ std::string ResourcePath(std::string fileName) {
         throw std::runtime_error("GetModuleFileName failed a bit");
 }
 
+size_t PeakMemoryUsage() {
+    PROCESS_MEMORY_COUNTERS counters;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+}
@@ -7,5 +7,9 @@
 #pragma once
 
 #include <string>
+#include <cstddef>
 
 std::string ResourcePath(std::string fileName);
+
+// the largest amount of physical memory the process has used so far in bytes, 0 if unknown
+size_t PeakMemoryUsage();
@@ -1,6 +1,9 @@
 #include "Bitmap.h"
 #include <stdexcept>
 #include <cstdlib>
+#include <cmath>
+#include <cstdio>
+#include <vector>
 
 #define STBI_FAILURE_USERMSG
 #define STB_IMAGE_IMPLEMENTATION
@@ -137,6 +140,27 @@ inline unsigned GetPixelOffset(unsigned col, unsigned row, unsigned width, unsig
     return (row*width + col)*format;
 }
 
+struct SRGBTable {
+    float linear[256];
+
+    SRGBTable() {
+        for(int i = 0; i < 256; ++i){
+            float c = i / 255.0f;
+            linear[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+    }
+};
+
+static float SRGBToLinear(unsigned char value) {
+    static const SRGBTable table; //initialised once, thread safe
+    return table.linear[value];
+}
+
+static unsigned char LinearToSRGB(float value) {
+    float c = (value <= 0.0031308f) ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return (unsigned char)(c * 255.0f + 0.5f);
+}
+
 inline bool RectsOverlap(unsigned srcCol, unsigned srcRow, unsigned destCol, unsigned destRow, unsigned width, unsigned height){
     unsigned colDiff = srcCol > destCol ? srcCol - destCol : destCol - srcCol;
     if(colDiff < width)
@@ -173,6 +197,106 @@ Bitmap Bitmap::bitmapFromFile(std::string filePath) {
     return bmp;
 }
 
+struct PNGCrcTable {
+    unsigned long entries[256];
+
+    PNGCrcTable() {
+        for(unsigned long n = 0; n < 256; ++n){
+            unsigned long c = n;
+            for(int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+            entries[n] = c;
+        }
+    }
+};
+
+static unsigned long PNGCrc(const unsigned char* data, size_t length, unsigned long crc = 0xffffffffUL) {
+    static const PNGCrcTable table;
+    for(size_t i = 0; i < length; ++i)
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+static void AppendBigEndian(std::vector<unsigned char>& out, unsigned long value) {
+    out.push_back((unsigned char)(value >> 24));
+    out.push_back((unsigned char)(value >> 16));
+    out.push_back((unsigned char)(value >> 8));
+    out.push_back((unsigned char)value);
+}
+
+static void AppendPNGChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data) {
+    AppendBigEndian(out, (unsigned long)data.size());
+    size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    AppendBigEndian(out, PNGCrc(&out[typeStart], out.size() - typeStart) ^ 0xffffffffUL);
+}
+
+void Bitmap::writeToPNGFile(std::string filePath) const {
+    //PNG color types in the same order as Format: gray, gray + alpha, RGB, RGBA
+    static const unsigned char colorTypes[] = { 0, 0, 4, 2, 6 };
+
+    std::vector<unsigned char> header;
+    AppendBigEndian(header, _width);
+    AppendBigEndian(header, _height);
+    header.push_back(8); //bits per channel
+    header.push_back(colorTypes[_format]);
+    header.push_back(0); //deflate
+    header.push_back(0); //adaptive filtering
+    header.push_back(0); //no interlace
+
+    //every row starts with filter type 0 (none)
+    size_t rowSize = _width * _format;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowSize + 1) * _height);
+    for(unsigned row = 0; row < _height; ++row){
+        raw.push_back(0);
+        const unsigned char* rowPixels = _pixels + GetPixelOffset(0, row, _width, _height, _format);
+        raw.insert(raw.end(), rowPixels, rowPixels + rowSize);
+    }
+
+    //zlib stream made of stored (uncompressed) deflate blocks
+    std::vector<unsigned char> zlib;
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    size_t offset = 0;
+    do {
+        size_t blockSize = raw.size() - offset;
+        if(blockSize > 65535)
+            blockSize = 65535;
+        bool lastBlock = (offset + blockSize == raw.size());
+        zlib.push_back(lastBlock ? 1 : 0);
+        zlib.push_back((unsigned char)(blockSize & 0xff));
+        zlib.push_back((unsigned char)(blockSize >> 8));
+        zlib.push_back((unsigned char)(~blockSize & 0xff));
+        zlib.push_back((unsigned char)((~blockSize >> 8) & 0xff));
+        if(blockSize > 0)
+            zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+        offset += blockSize;
+    } while(offset < raw.size());
+
+    unsigned long adlerA = 1, adlerB = 0;
+    for(size_t i = 0; i < raw.size(); ++i){
+        adlerA = (adlerA + raw[i]) % 65521;
+        adlerB = (adlerB + adlerA) % 65521;
+    }
+    AppendBigEndian(zlib, (adlerB << 16) | adlerA);
+
+    static const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    std::vector<unsigned char> file(signature, signature + sizeof(signature));
+    AppendPNGChunk(file, "IHDR", header);
+    AppendPNGChunk(file, "IDAT", zlib);
+    AppendPNGChunk(file, "IEND", std::vector<unsigned char>());
+
+    FILE* f = fopen(filePath.c_str(), "wb");
+    if(!f)
+        throw std::runtime_error(std::string("Failed to open file for writing: ") + filePath);
+    size_t written = fwrite(&file[0], 1, file.size(), f);
+    fclose(f);
+    if(written != file.size())
+        throw std::runtime_error(std::string("Failed to write file: ") + filePath);
+}
+
 Bitmap::Bitmap(const Bitmap& other) :
     _pixels(NULL)
 {
@@ -184,6 +308,31 @@ Bitmap& Bitmap::operator = (const Bitmap& other) {
     return *this;
 }
 
+Bitmap::Bitmap(Bitmap&& other) :
+    _format(other._format),
+    _width(other._width),
+    _height(other._height),
+    _pixels(other._pixels)
+{
+    other._width = 0;
+    other._height = 0;
+    other._pixels = NULL;
+}
+
+Bitmap& Bitmap::operator = (Bitmap&& other) {
+    if(this != &other) {
+        if(_pixels) free(_pixels);
+        _format = other._format;
+        _width = other._width;
+        _height = other._height;
+        _pixels = other._pixels;
+        other._width = 0;
+        other._height = 0;
+        other._pixels = NULL;
+    }
+    return *this;
+}
+
 unsigned int Bitmap::width() const {
     return _width;
 }
@@ -248,6 +397,50 @@ void Bitmap::rotate90CounterClockwise() {
     _width = swapTmp;
 }
 
+void Bitmap::downsample(bool srgb) {
+    unsigned newWidth = (_width > 1) ? _width / 2 : 1;
+    unsigned newHeight = (_height > 1) ? _height / 2 : 1;
+    unsigned char* newPixels = (unsigned char*) malloc(_format*newWidth*newHeight);
+
+    //grayscale alpha and RGBA keep their alpha in the last channel
+    unsigned colorChannels = (_format == Format_GrayscaleAlpha || _format == Format_RGBA) ? _format - 1 : _format;
+
+    for(unsigned row = 0; row < newHeight; ++row){
+        unsigned row0 = row * 2;
+        unsigned row1 = (row0 + 1 < _height) ? row0 + 1 : row0;
+        for(unsigned col = 0; col < newWidth; ++col){
+            unsigned col0 = col * 2;
+            unsigned col1 = (col0 + 1 < _width) ? col0 + 1 : col0;
+            const unsigned char* src[4] = {
+                _pixels + GetPixelOffset(col0, row0, _width, _height, _format),
+                _pixels + GetPixelOffset(col1, row0, _width, _height, _format),
+                _pixels + GetPixelOffset(col0, row1, _width, _height, _format),
+                _pixels + GetPixelOffset(col1, row1, _width, _height, _format)
+            };
+            unsigned char* dest = newPixels + GetPixelOffset(col, row, newWidth, newHeight, _format);
+
+            for(unsigned channel = 0; channel < (unsigned)_format; ++channel){
+                if(srgb && channel < colorChannels){
+                    float sum = 0.0f;
+                    for(int i = 0; i < 4; ++i)
+                        sum += SRGBToLinear(src[i][channel]);
+                    dest[channel] = LinearToSRGB(sum * 0.25f);
+                } else {
+                    unsigned sum = 0;
+                    for(int i = 0; i < 4; ++i)
+                        sum += src[i][channel];
+                    dest[channel] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    free(_pixels);
+    _pixels = newPixels;
+    _width = newWidth;
+    _height = newHeight;
+}
+
 void Bitmap::copyRectFromBitmap(const Bitmap& src, 
                                 unsigned srcCol, 
                                 unsigned srcRow, 
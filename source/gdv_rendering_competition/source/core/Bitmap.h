@@ -21,6 +21,12 @@ namespace core {
         ~Bitmap();
         
         static Bitmap bitmapFromFile(std::string filePath);
+
+        /**
+         Writes the bitmap as an uncompressed PNG, the first row is the top of the image.
+         Throws if the file can't be written.
+         */
+        void writeToPNGFile(std::string filePath) const;
                 
         unsigned width() const;
         
@@ -37,6 +43,13 @@ namespace core {
         void flipVertically();
         
         void rotate90CounterClockwise();
+
+        /**
+         Halves width and height (rounding down, but never below 1) with a 2x2 box filter.
+         If `srgb` is true the color channels are averaged in linear space, alpha always is linear.
+         Calling this until the bitmap is 1x1 gives the mipmap chain.
+         */
+        void downsample(bool srgb);
         
         void copyRectFromBitmap(const Bitmap& src, 
                                 unsigned srcCol, 
@@ -49,6 +62,13 @@ namespace core {
         Bitmap(const Bitmap& other);
         
         Bitmap& operator = (const Bitmap& other);
+
+        /**
+         Takes over the pixels of `other` without copying them, `other` is left 0x0 and empty.
+         */
+        Bitmap(Bitmap&& other);
+
+        Bitmap& operator = (Bitmap&& other);
         
     private:
         Format _format;
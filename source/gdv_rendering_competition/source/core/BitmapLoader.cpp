@@ -0,0 +1,57 @@
+#include "BitmapLoader.h"
+#include <stdexcept>
+#include <utility>
+
+using namespace core;
+
+BitmapLoader::BitmapLoader(JobSystem& jobs) :
+    _jobs(jobs)
+{
+}
+
+BitmapLoader::~BitmapLoader()
+{
+    for(size_t i = 0; i < _items.size(); ++i) {
+        if(_items[i]->job)
+            _jobs.wait(_items[i]->job);
+    }
+}
+
+size_t BitmapLoader::load(const Decode& decode)
+{
+    _items.push_back(std::unique_ptr<Item>(new Item()));
+    Item* item = _items.back().get();
+
+    //jobs must not throw, the error waits in the item until take()
+    item->job = _jobs.create([item, decode]() {
+        try {
+            item->bitmap.reset(new Bitmap(decode()));
+        } catch(...) {
+            item->error = std::current_exception();
+        }
+    });
+    _jobs.run(item->job);
+    return _items.size() - 1;
+}
+
+size_t BitmapLoader::count() const
+{
+    return _items.size();
+}
+
+Bitmap BitmapLoader::take(size_t index)
+{
+    Item& item = *_items.at(index);
+    if(!item.job)
+        throw std::runtime_error("BitmapLoader bitmap was already taken");
+
+    _jobs.wait(item.job);
+    item.job = NULL;
+    if(item.error)
+        std::rethrow_exception(item.error);
+
+    //the decoded pixels are handed over, not copied
+    Bitmap bitmap(std::move(*item.bitmap));
+    item.bitmap.reset();
+    return bitmap;
+}
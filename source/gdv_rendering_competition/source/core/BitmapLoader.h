@@ -0,0 +1,63 @@
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Bitmap.h"
+#include "JobSystem.h"
+
+namespace core {
+
+    /**
+     Decodes bitmaps on the threads of a JobSystem while the caller goes on with
+     other work.
+
+     load() starts a job and returns right away. take() waits for one bitmap,
+     running queued jobs in the meantime, and hands it over. Taking the bitmaps in
+     order and uploading each one right away overlaps the uploads with the
+     decoding of the rest, so loading takes about as long as the slowest file plus
+     the uploads instead of the sum of all files.
+     */
+    class BitmapLoader {
+    public:
+        typedef std::function<Bitmap()> Decode;
+
+        explicit BitmapLoader(JobSystem& jobs);
+
+        /**
+         Waits for the bitmaps that were not taken.
+         */
+        ~BitmapLoader();
+
+        /**
+         Runs `decode` in a job, e.g. Bitmap::bitmapFromFile() plus whatever the bitmap needs
+         before it is used, like flipVertically().
+
+         @return the index of the bitmap for take()
+         */
+        size_t load(const Decode& decode);
+
+        size_t count() const;
+
+        /**
+         Waits until bitmap `index` is decoded and returns it. An exception thrown by its
+         `decode` is thrown again here. Every bitmap can only be taken once.
+         */
+        Bitmap take(size_t index);
+
+    private:
+        struct Item {
+            JobSystem::Job* job; //NULL once taken
+            std::unique_ptr<Bitmap> bitmap;
+            std::exception_ptr error;
+        };
+
+        JobSystem& _jobs;
+        std::vector<std::unique_ptr<Item> > _items; //the jobs write into the items, so they must not move
+
+        //copying disabled
+        BitmapLoader(const BitmapLoader&);
+        const BitmapLoader& operator=(const BitmapLoader&);
+    };
+}
@@ -0,0 +1,115 @@
+#include "CameraPath.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace core;
+
+//uniform Catmull-Rom between p1 and p2
+static glm::vec3 CatmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
+{
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * ((2.0f * p1) +
+                   (p2 - p0) * t +
+                   (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+CameraPath::CameraPath()
+{
+}
+
+CameraPath CameraPath::pathFromFile(const std::string& filePath)
+{
+    std::ifstream f(filePath.c_str());
+    if(!f.is_open())
+        throw std::runtime_error(std::string("Failed to open camera path file: ") + filePath);
+
+    CameraPath path;
+    std::string line;
+    unsigned lineNumber = 0;
+    while(std::getline(f, line)) {
+        ++lineNumber;
+        if(line.find_first_not_of(" \t\r") == std::string::npos || line[line.find_first_not_of(" \t")] == '#')
+            continue;
+
+        std::istringstream values(line);
+        Keyframe keyframe;
+        values >> keyframe.time
+               >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+               >> keyframe.target.x >> keyframe.target.y >> keyframe.target.z;
+        if(values.fail()) {
+            std::stringstream msg;
+            msg << "Invalid keyframe in " << filePath << " line " << lineNumber;
+            throw std::runtime_error(msg.str());
+        }
+        path.addKeyframe(keyframe);
+    }
+
+    if(path.keyframeCount() == 0)
+        throw std::runtime_error(std::string("Camera path file has no keyframes: ") + filePath);
+    return path;
+}
+
+void CameraPath::saveToFile(const std::string& filePath) const
+{
+    std::ofstream f(filePath.c_str(), std::ios::out | std::ios::trunc);
+    if(!f.is_open())
+        throw std::runtime_error(std::string("Failed to open camera path file for writing: ") + filePath);
+
+    f << "# time positionX positionY positionZ targetX targetY targetZ\n";
+    for(size_t i = 0; i < _keyframes.size(); ++i) {
+        const Keyframe& k = _keyframes[i];
+        f << k.time << ' '
+          << k.position.x << ' ' << k.position.y << ' ' << k.position.z << ' '
+          << k.target.x << ' ' << k.target.y << ' ' << k.target.z << '\n';
+    }
+
+    if(!f)
+        throw std::runtime_error(std::string("Failed to write camera path file: ") + filePath);
+}
+
+void CameraPath::addKeyframe(const Keyframe& keyframe)
+{
+    if(!_keyframes.empty() && keyframe.time <= _keyframes.back().time)
+        throw std::runtime_error("Camera path keyframes must have increasing times");
+    _keyframes.push_back(keyframe);
+}
+
+size_t CameraPath::keyframeCount() const
+{
+    return _keyframes.size();
+}
+
+float CameraPath::duration() const
+{
+    return _keyframes.empty() ? 0.0f : _keyframes.back().time;
+}
+
+CameraPath::Keyframe CameraPath::sample(float time) const
+{
+    if(_keyframes.empty())
+        throw std::runtime_error("Can't sample an empty camera path");
+
+    if(time <= _keyframes.front().time)
+        return _keyframes.front();
+    if(time >= _keyframes.back().time)
+        return _keyframes.back();
+
+    //the segment from keyframe i to i + 1 contains `time`, the ends are repeated for the outer control points
+    size_t i = 0;
+    while(_keyframes[i + 1].time < time)
+        ++i;
+    const Keyframe& k0 = _keyframes[i > 0 ? i - 1 : i];
+    const Keyframe& k1 = _keyframes[i];
+    const Keyframe& k2 = _keyframes[i + 1];
+    const Keyframe& k3 = _keyframes[i + 2 < _keyframes.size() ? i + 2 : i + 1];
+    float t = (time - k1.time) / (k2.time - k1.time);
+
+    Keyframe result;
+    result.time = time;
+    result.position = CatmullRom(k0.position, k1.position, k2.position, k3.position, t);
+    result.target = CatmullRom(k0.target, k1.target, k2.target, k3.target, t);
+    return result;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace core {
+
+    /**
+     A camera flight made of keyframes, e.g. recorded while flying through a scene,
+     that can be played back exactly the same way again.
+
+     The position and the point the camera looks at are interpolated with
+     Catmull-Rom splines, so the flight passes through every keyframe.
+
+     The file format is plain text with one keyframe per line:
+     time positionX positionY positionZ targetX targetY targetZ
+     Empty lines and lines starting with # are ignored.
+     */
+    class CameraPath {
+    public:
+        struct Keyframe {
+            float time; //seconds since the start of the path
+            glm::vec3 position;
+            glm::vec3 target;
+        };
+
+        CameraPath();
+
+        /**
+         Throws an exception if the file can not be read or is not a valid path.
+         */
+        static CameraPath pathFromFile(const std::string& filePath);
+
+        void saveToFile(const std::string& filePath) const;
+
+        /**
+         Appends a keyframe, its time must be after the time of the last one.
+         */
+        void addKeyframe(const Keyframe& keyframe);
+
+        size_t keyframeCount() const;
+
+        /**
+         @return the time of the last keyframe
+         */
+        float duration() const;
+
+        /**
+         The camera at `time`, times outside of the path are clamped to it.
+         The path must have at least one keyframe.
+         */
+        Keyframe sample(float time) const;
+
+    private:
+        std::vector<Keyframe> _keyframes;
+    };
+}
@@ -0,0 +1,226 @@
+#include "ChunkMesher.h"
+
+using namespace core;
+
+namespace {
+    struct FaceVertex {
+        GLfloat x, y, z;
+        GLfloat u, v;
+    };
+
+    struct Face {
+        int axis;  //0 = x, 1 = y, 2 = z
+        int sign;  //direction of the neighbour that hides this face along `axis`
+        int uAxis; //axis along which the u texture coordinate changes
+        int vAxis; //axis along which the v texture coordinate changes
+        FaceVertex vertices[6];
+    };
+
+    //the six sides of a cube from -1 to 1, with the same corners and uvs as the cube used for instancing
+    const Face FACES[6] = {
+        // bottom
+        { 1,-1, 0, 2, { {-1,-1,-1, 0,0}, { 1,-1,-1, 1,0}, {-1,-1, 1, 0,1}, { 1,-1,-1, 1,0}, { 1,-1, 1, 1,1}, {-1,-1, 1, 0,1} } },
+        // top
+        { 1, 1, 0, 2, { {-1, 1,-1, 0,0}, {-1, 1, 1, 0,1}, { 1, 1,-1, 1,0}, { 1, 1,-1, 1,0}, {-1, 1, 1, 0,1}, { 1, 1, 1, 1,1} } },
+        // front
+        { 2, 1, 0, 1, { {-1,-1, 1, 1,0}, { 1,-1, 1, 0,0}, {-1, 1, 1, 1,1}, { 1,-1, 1, 0,0}, { 1, 1, 1, 0,1}, {-1, 1, 1, 1,1} } },
+        // back
+        { 2,-1, 0, 1, { {-1,-1,-1, 0,0}, {-1, 1,-1, 0,1}, { 1,-1,-1, 1,0}, { 1,-1,-1, 1,0}, {-1, 1,-1, 0,1}, { 1, 1,-1, 1,1} } },
+        // left
+        { 0,-1, 1, 2, { {-1,-1, 1, 0,1}, {-1, 1,-1, 1,0}, {-1,-1,-1, 0,0}, {-1,-1, 1, 0,1}, {-1, 1, 1, 1,1}, {-1, 1,-1, 1,0} } },
+        // right
+        { 0, 1, 1, 2, { { 1,-1, 1, 1,1}, { 1,-1,-1, 1,0}, { 1, 1,-1, 0,0}, { 1,-1, 1, 1,1}, { 1, 1,-1, 0,0}, { 1, 1, 1, 0,1} } }
+    };
+
+    //a visible rectangle of faces, waiting to be sorted by block id
+    struct PendingQuad {
+        VoxelWorld::BlockId id;
+        unsigned char face;
+        int min[3];  //world block coordinates of the first block
+        int size[3]; //extent in blocks, 1 along the face normal
+    };
+}
+
+ChunkMesher::ChunkMesher(const VoxelWorld& world, GLfloat blockSize) :
+    _world(world),
+    _blockSize(blockSize),
+    _mode(NAIVE)
+{
+    for(int id = 0; id < 256; ++id) {
+        _layers[id] = (GLfloat)id;
+        _transparent[id] = false;
+    }
+}
+
+void ChunkMesher::setBlock(VoxelWorld::BlockId id, GLfloat layer, bool transparent) {
+    _layers[id] = layer;
+    _transparent[id] = transparent;
+}
+
+bool ChunkMesher::isTransparent(VoxelWorld::BlockId id) const {
+    return _transparent[id];
+}
+
+ChunkMesher::Mode ChunkMesher::mode() const {
+    return _mode;
+}
+
+void ChunkMesher::setMode(Mode mode) {
+    _mode = mode;
+}
+
+bool ChunkMesher::_faceVisible(VoxelWorld::BlockId id, VoxelWorld::BlockId neighbour) const {
+    if(neighbour == VoxelWorld::EMPTY)
+        return true;
+    if(!_transparent[neighbour])
+        return false;
+    return neighbour != id;
+}
+
+size_t ChunkMesher::build(const VoxelWorld::Chunk& chunk, std::vector<Vertex>& vertices, std::vector<Range>& ranges) const {
+    const int size = VoxelWorld::CHUNK_SIZE;
+    const int origin[3] = { chunk.coord.x * size, chunk.coord.y * size, chunk.coord.z * size };
+
+    //collect the visible quads and count them per block id
+    std::vector<PendingQuad> quads;
+    size_t quadsPerId[256] = { 0 };
+    size_t culled = 0;
+
+    //one slice of faces at a time, mask[j][i] is the block id of the visible face or EMPTY
+    VoxelWorld::BlockId mask[VoxelWorld::CHUNK_SIZE][VoxelWorld::CHUNK_SIZE];
+
+    for(int f = 0; f < 6; ++f) {
+        const Face& face = FACES[f];
+        const int axis = face.axis;
+        const int a = (axis + 1) % 3; //the two axes of the slice
+        const int b = (axis + 2) % 3;
+
+        for(int slice = 0; slice < size; ++slice) {
+            for(int j = 0; j < size; ++j) {
+                for(int i = 0; i < size; ++i) {
+                    int local[3];
+                    local[axis] = slice;
+                    local[a] = i;
+                    local[b] = j;
+
+                    mask[j][i] = VoxelWorld::EMPTY;
+                    VoxelWorld::BlockId id = chunk.get(local[0], local[1], local[2]);
+                    if(id == VoxelWorld::EMPTY)
+                        continue;
+
+                    //inside the chunk read the blocks directly, at the border ask the world
+                    int n[3] = { local[0], local[1], local[2] };
+                    n[axis] += face.sign;
+                    VoxelWorld::BlockId neighbour;
+                    if(n[axis] >= 0 && n[axis] < size)
+                        neighbour = chunk.get(n[0], n[1], n[2]);
+                    else
+                        neighbour = _world.get(origin[0] + n[0], origin[1] + n[1], origin[2] + n[2]);
+
+                    if(_faceVisible(id, neighbour))
+                        mask[j][i] = id;
+                    else
+                        ++culled;
+                }
+            }
+
+            //turn the mask into quads, 1x1 or as large as possible
+            for(int j = 0; j < size; ++j) {
+                for(int i = 0; i < size; ) {
+                    VoxelWorld::BlockId id = mask[j][i];
+                    if(id == VoxelWorld::EMPTY) {
+                        ++i;
+                        continue;
+                    }
+
+                    int width = 1;
+                    int height = 1;
+                    if(_mode == GREEDY) {
+                        while(i + width < size && mask[j][i + width] == id)
+                            ++width;
+
+                        bool rowMatches = true;
+                        while(j + height < size && rowMatches) {
+                            for(int k = 0; k < width; ++k) {
+                                if(mask[j + height][i + k] != id) {
+                                    rowMatches = false;
+                                    break;
+                                }
+                            }
+                            if(rowMatches)
+                                ++height;
+                        }
+                    }
+
+                    for(int y = 0; y < height; ++y) {
+                        for(int x = 0; x < width; ++x)
+                            mask[j + y][i + x] = VoxelWorld::EMPTY;
+                    }
+
+                    PendingQuad quad;
+                    quad.id = id;
+                    quad.face = (unsigned char)f;
+                    quad.min[axis] = origin[axis] + slice;
+                    quad.min[a] = origin[a] + i;
+                    quad.min[b] = origin[b] + j;
+                    quad.size[axis] = 1;
+                    quad.size[a] = width;
+                    quad.size[b] = height;
+                    quads.push_back(quad);
+                    ++quadsPerId[id];
+
+                    i += width;
+                }
+            }
+        }
+    }
+
+    //one range per block id, in id order
+    ranges.clear();
+    size_t firstQuad[256];
+    size_t total = 0;
+    for(int id = 0; id < 256; ++id) {
+        firstQuad[id] = total;
+        if(quadsPerId[id] == 0)
+            continue;
+
+        Range range;
+        range.id = (VoxelWorld::BlockId)id;
+        range.start = (GLint)(total * 6);
+        range.count = (GLsizei)(quadsPerId[id] * 6);
+        range.transparent = _transparent[id];
+        ranges.push_back(range);
+        total += quadsPerId[id];
+    }
+
+    //write the vertices of every quad into the range of its block id
+    vertices.resize(total * 6);
+    const GLfloat half = _blockSize * 0.5f;
+    for(size_t q = 0; q < quads.size(); ++q) {
+        const PendingQuad& quad = quads[q];
+        const Face& face = FACES[quad.face];
+        glm::vec3 normal(0.0f);
+        normal[face.axis] = (GLfloat)face.sign;
+
+        //the faces of the first and the last block of the quad along every axis
+        glm::vec3 low, high;
+        for(int axis = 0; axis < 3; ++axis) {
+            low[axis] = (GLfloat)quad.min[axis] * _blockSize - half;
+            high[axis] = (GLfloat)(quad.min[axis] + quad.size[axis] - 1) * _blockSize + half;
+        }
+
+        Vertex* out = &vertices[firstQuad[quad.id]++ * 6];
+        for(int v = 0; v < 6; ++v) {
+            const FaceVertex& corner = face.vertices[v];
+            out[v].position = glm::vec3(corner.x < 0 ? low.x : high.x,
+                                        corner.y < 0 ? low.y : high.y,
+                                        corner.z < 0 ? low.z : high.z);
+            //one texture repeat per block
+            out[v].texCoord = glm::vec2(corner.u * (GLfloat)quad.size[face.uAxis], corner.v * (GLfloat)quad.size[face.vAxis]);
+            out[v].normal = normal;
+            out[v].layer = _layers[quad.id];
+        }
+    }
+
+    return culled;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "VoxelWorld.h"
+
+namespace core {
+
+    /**
+     Turns the blocks of one VoxelWorld chunk into a triangle list. Only faces that
+     can be seen are emitted, i.e. faces whose neighbour is empty or transparent.
+     Neighbours in the surrounding chunks are taken into account.
+
+     The vertices are in world space and grouped by block id, so every block type
+     ends up in one contiguous range of the vertex list.
+
+     In GREEDY mode neighbouring faces of the same block type that lie in one plane
+     are merged into a single quad. The texture coordinates of a merged quad go up
+     to its size in blocks, so the block textures need GL_REPEAT wrapping.
+     */
+    class ChunkMesher {
+    public:
+        enum Mode {
+            NAIVE,  //one quad per visible face
+            GREEDY  //coplanar faces of the same block type merged into rectangles
+        };
+
+        struct Vertex {
+            glm::vec3 position;
+            glm::vec2 texCoord;
+            glm::vec3 normal;
+            GLfloat layer; //texture layer of the block this face belongs to
+        };
+
+        //all faces of one block type, `start` and `count` are in vertices
+        struct Range {
+            VoxelWorld::BlockId id;
+            GLint start;
+            GLsizei count;
+            bool transparent; //as given to setBlock(), the range has to be drawn after the opaque ones
+        };
+
+        ChunkMesher(const VoxelWorld& world, GLfloat blockSize);
+
+        /**
+         Sets the texture layer written into the vertices of block `id` and whether the
+         block can be looked through. Faces between two blocks of the same transparent
+         type are dropped, faces of opaque blocks next to transparent ones are kept.
+         By default every block is opaque and uses layer `id`.
+         */
+        void setBlock(VoxelWorld::BlockId id, GLfloat layer, bool transparent);
+
+        bool isTransparent(VoxelWorld::BlockId id) const;
+
+        Mode mode() const;
+
+        void setMode(Mode mode);
+
+        /**
+         Replaces the contents of `vertices` and `ranges` with the mesh of `chunk`.
+
+         @return the number of faces that were culled because they are hidden
+         */
+        size_t build(const VoxelWorld::Chunk& chunk, std::vector<Vertex>& vertices, std::vector<Range>& ranges) const;
+
+    private:
+        const VoxelWorld& _world;
+        GLfloat _blockSize;
+        Mode _mode;
+        GLfloat _layers[256];
+        bool _transparent[256];
+
+        bool _faceVisible(VoxelWorld::BlockId id, VoxelWorld::BlockId neighbour) const;
+
+        //copying disabled
+        ChunkMesher(const ChunkMesher&);
+        const ChunkMesher& operator=(const ChunkMesher&);
+    };
+}
@@ -0,0 +1,38 @@
+#include "FixedTimestep.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace core;
+
+FixedTimestep::FixedTimestep(double stepSeconds, int maxSteps) :
+    _stepSeconds(stepSeconds),
+    _maxSteps(maxSteps),
+    _accumulator(0.0)
+{
+    if(stepSeconds <= 0.0)
+        throw std::runtime_error("FixedTimestep step must be positive");
+    if(maxSteps < 1)
+        throw std::runtime_error("FixedTimestep needs at least one step per advance");
+}
+
+double FixedTimestep::stepSeconds() const
+{
+    return _stepSeconds;
+}
+
+int FixedTimestep::advance(double secondsElapsed)
+{
+    _accumulator += std::max(secondsElapsed, 0.0);
+    int steps = (int)std::min(_accumulator / _stepSeconds, (double)_maxSteps);
+    _accumulator -= steps * _stepSeconds;
+
+    //behind by more than the allowed steps, the rest is dropped
+    if(steps == _maxSteps)
+        _accumulator = std::min(_accumulator, _stepSeconds);
+    return steps;
+}
+
+float FixedTimestep::alpha() const
+{
+    return (float)std::min(_accumulator / _stepSeconds, 1.0);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+namespace core {
+
+    /**
+     Turns the irregular time between frames into simulation steps of a fixed length.
+
+     The time that is left over after the last whole step is kept for the next
+     frame. alpha() tells how far the current time is between the last two steps,
+     so the renderer can blend their states and motion stays smooth when the
+     frame rate and the simulation rate differ.
+
+     When a frame takes very long, at most `maxSteps` steps are simulated and the
+     rest of the time is dropped, so a slow frame cannot cause ever slower ones.
+     */
+    class FixedTimestep {
+    public:
+        FixedTimestep(double stepSeconds, int maxSteps);
+
+        double stepSeconds() const;
+
+        /**
+         Adds the time that has passed since the last call.
+
+         @return the number of steps to simulate now
+         */
+        int advance(double secondsElapsed);
+
+        /**
+         @return from 0 to 1, how far the time after the last advance() is between the
+                 state before the last step and the state after it
+         */
+        float alpha() const;
+
+    private:
+        double _stepSeconds;
+        int _maxSteps;
+        double _accumulator; //time that has passed but was not simulated yet
+    };
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace core {
+
+    /**
+     Overlaps the update of the next frame with the rendering of the current one.
+
+     There are two copies of the state a frame is rendered from. The update writes
+     into the back copy on a thread of its own, while the caller renders from the
+     front copy. Once both are done, swap() exchanges the copies by flipping an
+     atomic index, nothing is copied or locked for the hand-off. Throughput then
+     approaches the slower of the two stages instead of their sum.
+
+     The update only starts when the caller calls beginUpdate(), so the caller can
+     change whatever the update reads (like the input) between waitForUpdate()
+     and beginUpdate() without any locks.
+
+     Without a thread of its own, beginUpdate() runs the update right away. The
+     frames are the same either way.
+     */
+    template<typename State>
+    class FramePipeline {
+    public:
+        typedef std::function<void(State&)> Update;
+
+        explicit FramePipeline(bool threaded) :
+            _front(0),
+            _working(false),
+            _stopping(false)
+        {
+            if(threaded)
+                _worker = std::thread(&FramePipeline::_run, this);
+        }
+
+        ~FramePipeline() {
+            if(_worker.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _stopping = true;
+                }
+                _wakeWorker.notify_one();
+                _worker.join();
+            }
+        }
+
+        bool threaded() const {
+            return _worker.joinable();
+        }
+
+        /**
+         Calls `update` with the back copy, on the pipeline's thread if it has one.
+         The previous update must be finished, see waitForUpdate().
+         */
+        void beginUpdate(const Update& update) {
+            if(!_worker.joinable()) {
+                update(_states[1 - _front]);
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _update = update;
+                _working = true;
+            }
+            _wakeWorker.notify_one();
+        }
+
+        /**
+         Waits until the update started by beginUpdate() is done. An exception thrown
+         by the update is thrown again here.
+         */
+        void waitForUpdate() {
+            if(_worker.joinable()) {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _updateDone.wait(lock, [this]() { return !_working; });
+            }
+
+            if(_error) {
+                std::exception_ptr error = _error;
+                _error = std::exception_ptr();
+                std::rethrow_exception(error);
+            }
+        }
+
+        /**
+         Makes the updated back copy the front copy. No update may be running.
+         */
+        void swap() {
+            _front.store(1 - _front.load());
+        }
+
+        /**
+         The state to render from, stays the same until the next swap().
+         */
+        const State& front() const {
+            return _states[_front.load()];
+        }
+
+    private:
+        State _states[2];
+        std::atomic<int> _front;
+
+        std::thread _worker;
+        std::mutex _mutex;
+        std::condition_variable _wakeWorker;
+        std::condition_variable _updateDone;
+        Update _update;
+        bool _working;
+        bool _stopping;
+        std::exception_ptr _error;
+
+        void _run() {
+            for(;;) {
+                Update update;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _wakeWorker.wait(lock, [this]() { return _working || _stopping; });
+                    if(_stopping)
+                        return;
+                    update.swap(_update);
+                }
+
+                try {
+                    update(_states[1 - _front.load()]);
+                } catch(...) {
+                    _error = std::current_exception();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _working = false;
+                }
+                _updateDone.notify_one();
+            }
+        }
+
+        //copying disabled
+        FramePipeline(const FramePipeline&);
+        const FramePipeline& operator=(const FramePipeline&);
+    };
+}
@@ -0,0 +1,80 @@
+#include "Framebuffer.h"
+#include <stdexcept>
+
+using namespace core;
+
+Framebuffer::Framebuffer(GLsizei width, GLsizei height) :
+    _object(0),
+    _colorBuffer(0),
+    _depthBuffer(0),
+    _width(width),
+    _height(height)
+{
+    if(width <= 0 || height <= 0)
+        throw std::runtime_error("Framebuffer size must be positive");
+
+    glGenRenderbuffers(1, &_colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &_depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &_object);
+    glBindFramebuffer(GL_FRAMEBUFFER, _object);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthBuffer);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        glDeleteFramebuffers(1, &_object);
+        glDeleteRenderbuffers(1, &_colorBuffer);
+        glDeleteRenderbuffers(1, &_depthBuffer);
+        throw std::runtime_error("Framebuffer is incomplete");
+    }
+}
+
+Framebuffer::~Framebuffer() {
+    glDeleteFramebuffers(1, &_object);
+    glDeleteRenderbuffers(1, &_colorBuffer);
+    glDeleteRenderbuffers(1, &_depthBuffer);
+}
+
+GLuint Framebuffer::object() const {
+    return _object;
+}
+
+GLsizei Framebuffer::width() const {
+    return _width;
+}
+
+GLsizei Framebuffer::height() const {
+    return _height;
+}
+
+void Framebuffer::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, _object);
+    glViewport(0, 0, _width, _height);
+}
+
+Bitmap Framebuffer::readPixels() const {
+    Bitmap bitmap((unsigned)_width, (unsigned)_height, Bitmap::Format_RGB);
+
+    //the rows of a Bitmap are tightly packed, the binding and alignment are put back afterwards
+    GLint previous = 0;
+    GLint previousAlignment = 4;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+    glGetIntegerv(GL_PACK_ALIGNMENT, &previousAlignment);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _object);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, _width, _height, GL_RGB, GL_UNSIGNED_BYTE, bitmap.pixelBuffer());
+    glPixelStorei(GL_PACK_ALIGNMENT, previousAlignment);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)previous);
+
+    //GL returns the bottom row first
+    bitmap.flipVertically();
+    return bitmap;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <GL/glew.h>
+#include "Bitmap.h"
+
+namespace core {
+
+    /**
+     An offscreen render target with an RGBA8 color and a 24 bit depth renderbuffer.
+     Used instead of the window's default framebuffer when running headless.
+     */
+    class Framebuffer {
+    public:
+
+        Framebuffer(GLsizei width, GLsizei height);
+
+        ~Framebuffer();
+
+        GLuint object() const;
+
+        GLsizei width() const;
+
+        GLsizei height() const;
+
+        /**
+         Binds the framebuffer for drawing and reading and sets the viewport to cover it.
+         */
+        void bind() const;
+
+        /**
+         Reads back the color buffer, the first row of the bitmap is the top of the image.
+         */
+        Bitmap readPixels() const;
+
+    private:
+        GLuint _object;
+        GLuint _colorBuffer;
+        GLuint _depthBuffer;
+        GLsizei _width;
+        GLsizei _height;
+
+        //copying disabled
+        Framebuffer(const Framebuffer&);
+        const Framebuffer& operator=(const Framebuffer&);
+    };
+}
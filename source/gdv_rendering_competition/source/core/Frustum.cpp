@@ -0,0 +1,59 @@
+#include "Frustum.h"
+
+using namespace core;
+
+Frustum::Frustum()
+{
+    for(int i = 0; i < PLANE_COUNT; ++i)
+        _planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); //everything is inside
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+    update(viewProjection);
+}
+
+void Frustum::update(const glm::mat4& viewProjection) {
+    //glm matrices are column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    const glm::mat4& m = viewProjection;
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    _planes[LEFT] = row3 + row0;
+    _planes[RIGHT] = row3 - row0;
+    _planes[BOTTOM] = row3 + row1;
+    _planes[TOP] = row3 - row1;
+    _planes[NEAR_PLANE] = row3 + row2;
+    _planes[FAR_PLANE] = row3 - row2;
+
+    for(int i = 0; i < PLANE_COUNT; ++i)
+        _planes[i] /= glm::length(glm::vec3(_planes[i]));
+}
+
+const glm::vec4& Frustum::plane(Plane plane) const {
+    return _planes[plane];
+}
+
+bool Frustum::intersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+    for(int i = 0; i < PLANE_COUNT; ++i) {
+        const glm::vec4& p = _planes[i];
+
+        //the corner furthest along the plane normal, if even that one is outside the whole box is
+        glm::vec3 positive(p.x >= 0.0f ? boxMax.x : boxMin.x,
+                           p.y >= 0.0f ? boxMax.y : boxMin.y,
+                           p.z >= 0.0f ? boxMax.z : boxMin.z);
+        if(glm::dot(glm::vec3(p), positive) + p.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+    for(int i = 0; i < PLANE_COUNT; ++i) {
+        if(glm::dot(glm::vec3(_planes[i]), center) + _planes[i].w < -radius)
+            return false;
+    }
+    return true;
+}
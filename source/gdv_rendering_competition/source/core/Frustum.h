@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace core {
+
+    /**
+     The six clipping planes of a view-projection matrix, e.g. Camera::matrix().
+     The planes point inwards, so a point is inside if it is on the positive side of all six.
+     */
+    class Frustum {
+    public:
+        enum Plane { LEFT, RIGHT, BOTTOM, TOP, NEAR_PLANE, FAR_PLANE, PLANE_COUNT };
+
+        Frustum();
+
+        explicit Frustum(const glm::mat4& viewProjection);
+
+        /**
+         Extracts the planes from the rows of `viewProjection` (Gribb & Hartmann).
+         */
+        void update(const glm::mat4& viewProjection);
+
+        /**
+         @return the normalized plane, xyz is the normal and w the distance: dot(xyz, p) + w >= 0 inside
+         */
+        const glm::vec4& plane(Plane plane) const;
+
+        /**
+         Conservative box test: false only if the box is completely outside of one plane.
+         Boxes near the corners of the frustum may be reported as visible although they are not.
+         */
+        bool intersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+        bool intersectsSphere(const glm::vec3& center, float radius) const;
+
+    private:
+        glm::vec4 _planes[PLANE_COUNT];
+    };
+}
@@ -0,0 +1,263 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+
+using namespace core;
+
+class JobSystem::Job {
+public:
+    std::function<void()> work;
+    Job* parent;
+    std::atomic<size_t> unfinished; //1 for the work of the job itself plus the children that are not finished
+};
+
+struct JobSystem::Queue {
+    std::mutex mutex;
+    std::deque<Job*> jobs;
+
+    //counted by the thread that owns the deque
+    std::atomic<size_t> jobsRun;
+    std::atomic<size_t> steals;
+    std::atomic<uint64_t> idleNanoseconds;
+
+    Queue() : jobsRun(0), steals(0), idleNanoseconds(0) {}
+};
+
+namespace {
+    //which deque the current thread uses, threads outside any system have no `system`
+    struct ThreadQueue {
+        const JobSystem* system;
+        size_t queue;
+    };
+
+    thread_local ThreadQueue CurrentThreadQueue = { NULL, 0 };
+}
+
+JobSystem::JobSystem(size_t threadCount) :
+    _queuedJobs(0),
+    _stopping(false)
+{
+    if(threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if(threadCount == 0)
+        threadCount = 1;
+
+    //the waiting thread is one of the threads, its deque is the shared one at the end
+    for(size_t i = 0; i < threadCount; ++i)
+        _queues.push_back(std::unique_ptr<Queue>(new Queue()));
+    for(size_t i = 0; i + 1 < threadCount; ++i)
+        _workers.push_back(std::thread(&JobSystem::_workerMain, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stopping = true;
+    }
+    _wakeWorkers.notify_all();
+    for(size_t i = 0; i < _workers.size(); ++i)
+        _workers[i].join();
+}
+
+size_t JobSystem::threadCount() const
+{
+    return _workers.size() + 1;
+}
+
+JobSystem::Job* JobSystem::create(const std::function<void()>& work, Job* parent)
+{
+    Job* job = new Job();
+    job->work = work;
+    job->parent = parent;
+    job->unfinished = 1;
+    if(parent)
+        parent->unfinished.fetch_add(1);
+    return job;
+}
+
+void JobSystem::run(Job* job)
+{
+    //counted before it can be taken, so the count never drops below zero
+    _queuedJobs.fetch_add(1);
+    Queue& queue = *_queues[_queueOfThisThread()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+
+    //taking the lock makes sure a worker that just found nothing is already waiting
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+    }
+    _wakeWorkers.notify_one();
+}
+
+void JobSystem::wait(Job* job)
+{
+    size_t queue = _queueOfThisThread();
+    while(job->unfinished.load() > 0) {
+        Job* other = _takeJob(queue);
+        if(other)
+            _execute(other, queue);
+        else
+            std::this_thread::yield();
+    }
+    delete job;
+}
+
+void JobSystem::parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body)
+{
+    if(count == 0)
+        return;
+
+    grainSize = std::max(grainSize, (size_t)1);
+    if(_workers.empty() || count <= grainSize) {
+        body(0, count);
+        return;
+    }
+
+    //the first exception of any range, the others are dropped
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    std::function<void(size_t, size_t)> catchingBody = [&](size_t begin, size_t end) {
+        try {
+            body(begin, end);
+        } catch(...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if(!error)
+                error = std::current_exception();
+        }
+    };
+
+    //all ranges are children of one job, which does nothing itself
+    Job* root = create(std::function<void()>());
+    Queue& queue = *_queues[_queueOfThisThread()];
+    _queuedJobs.fetch_add((count + grainSize - 1) / grainSize);
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for(size_t begin = 0; begin < count; begin += grainSize) {
+            size_t end = std::min(begin + grainSize, count);
+            queue.jobs.push_back(create([&catchingBody, begin, end]() { catchingBody(begin, end); }, root));
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+    }
+    _wakeWorkers.notify_all();
+
+    _finish(root);
+    wait(root);
+    if(error)
+        std::rethrow_exception(error);
+}
+
+JobSystem::Stats JobSystem::stats() const
+{
+    Stats stats;
+    stats.jobs = 0;
+    stats.steals = 0;
+    uint64_t idleNanoseconds = 0;
+    for(size_t i = 0; i < _queues.size(); ++i) {
+        stats.jobs += _queues[i]->jobsRun.load();
+        stats.steals += _queues[i]->steals.load();
+        idleNanoseconds += _queues[i]->idleNanoseconds.load();
+    }
+    stats.idleSeconds = idleNanoseconds / 1e9;
+    return stats;
+}
+
+void JobSystem::resetStats()
+{
+    for(size_t i = 0; i < _queues.size(); ++i) {
+        _queues[i]->jobsRun = 0;
+        _queues[i]->steals = 0;
+        _queues[i]->idleNanoseconds = 0;
+    }
+}
+
+size_t JobSystem::_queueOfThisThread() const
+{
+    if(CurrentThreadQueue.system == this)
+        return CurrentThreadQueue.queue;
+    return _queues.size() - 1;
+}
+
+JobSystem::Job* JobSystem::_takeJob(size_t queue)
+{
+    //the newest job of the own deque first
+    {
+        Queue& own = *_queues[queue];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if(!own.jobs.empty()) {
+            Job* job = own.jobs.back();
+            own.jobs.pop_back();
+            _queuedJobs.fetch_sub(1);
+            return job;
+        }
+    }
+
+    //then the oldest job of any other deque, starting with the next one so not every thread tries the same first
+    for(size_t i = 1; i < _queues.size(); ++i) {
+        Queue& victim = *_queues[(queue + i) % _queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.jobs.empty()) {
+            Job* job = victim.jobs.front();
+            victim.jobs.pop_front();
+            _queuedJobs.fetch_sub(1);
+            _queues[queue]->steals.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return NULL;
+}
+
+void JobSystem::_execute(Job* job, size_t queue)
+{
+    if(job->work)
+        job->work();
+    _queues[queue]->jobsRun.fetch_add(1, std::memory_order_relaxed);
+    _finish(job);
+}
+
+void JobSystem::_finish(Job* job)
+{
+    //after the last decrement the job may already be deleted by wait(), so `parent` is read before
+    Job* parent = job->parent;
+    if(job->unfinished.fetch_sub(1) != 1)
+        return;
+
+    if(parent) {
+        delete job;
+        _finish(parent);
+    }
+}
+
+void JobSystem::_workerMain(size_t queue)
+{
+    CurrentThreadQueue.system = this;
+    CurrentThreadQueue.queue = queue;
+
+    for(;;) {
+        Job* job = _takeJob(queue);
+        if(job) {
+            _execute(job, queue);
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point idleStart = std::chrono::steady_clock::now();
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(_sleepMutex);
+            _wakeWorkers.wait(lock, [this] { return _stopping || _queuedJobs.load() > 0; });
+            stopping = _stopping;
+        }
+        std::chrono::nanoseconds idle = std::chrono::steady_clock::now() - idleStart;
+        _queues[queue]->idleNanoseconds.fetch_add((uint64_t)idle.count(), std::memory_order_relaxed);
+        if(stopping)
+            return;
+    }
+}
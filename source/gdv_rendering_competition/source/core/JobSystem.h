@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace core {
+
+    /**
+     Runs small jobs on a fixed set of worker threads, for work that does not fit a
+     single loop like ThreadPool::parallelFor(), e.g. loading, meshing and updates.
+
+     Every thread has a deque of jobs. A thread pushes the jobs it creates onto the
+     back of its own deque and also takes its next job from the back, so it stays on
+     the data that is still in its cache. A thread whose deque is empty steals the
+     oldest job from the front of another deque, which tends to be the biggest piece
+     of work left. Each deque has a lock of its own, so threads only contend for it
+     while one of them steals.
+
+     A job can have a parent, which only finishes once its own work and all of its
+     children are done, so waiting for the parent waits for the whole tree. Threads
+     that do not belong to the system, like the main thread, share one more deque,
+     and wait() runs other jobs instead of blocking. That makes it fine to wait from
+     inside a job.
+     */
+    class JobSystem {
+    public:
+        class Job;
+
+        struct Stats {
+            size_t jobs;        //jobs that were run
+            size_t steals;      //jobs taken from the deque of another thread
+            double idleSeconds; //time the workers had nothing to do, summed over all of them
+        };
+
+        /**
+         @param threadCount  the number of threads running jobs including one thread that waits,
+                             0 uses one per hardware thread
+         */
+        explicit JobSystem(size_t threadCount = 0);
+
+        ~JobSystem();
+
+        /**
+         @return the number of threads running jobs including one thread that waits
+         */
+        size_t threadCount() const;
+
+        /**
+         Creates a job that calls `work` when it is run, `work` must not throw. The job does
+         not finish before all of its children do, so children have to be created before
+         their parent is finished, e.g. from inside its work. The job only starts with run().
+         */
+        Job* create(const std::function<void()>& work, Job* parent = NULL);
+
+        /**
+         Queues `job` on the deque of the calling thread.
+         */
+        void run(Job* job);
+
+        /**
+         Runs jobs until `job` and all of its children are finished, then deletes `job`.
+         Every job without a parent has to be waited for exactly once, children are
+         deleted when they finish.
+         */
+        void wait(Job* job);
+
+        /**
+         Calls `body(begin, end)` for consecutive ranges of at most `grainSize` indices that
+         together cover 0 to count - 1, spread over all threads. Returns when all are done,
+         if `body` threw, the first exception is thrown again here.
+         */
+        void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body);
+
+        /**
+         The counters since the system was created or since the last resetStats().
+         */
+        Stats stats() const;
+
+        void resetStats();
+
+    private:
+        struct Queue;
+
+        //one per worker, the last one is shared by the threads outside the system
+        std::vector<std::unique_ptr<Queue>> _queues;
+        std::vector<std::thread> _workers;
+
+        //idle workers sleep until a job is queued
+        std::mutex _sleepMutex;
+        std::condition_variable _wakeWorkers;
+        std::atomic<size_t> _queuedJobs;
+        bool _stopping;
+
+        size_t _queueOfThisThread() const;
+        Job* _takeJob(size_t queue);
+        void _execute(Job* job, size_t queue);
+        void _finish(Job* job);
+        void _workerMain(size_t queue);
+
+        //copying disabled
+        JobSystem(const JobSystem&);
+        const JobSystem& operator=(const JobSystem&);
+    };
+}
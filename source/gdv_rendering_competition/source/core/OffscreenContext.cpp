@@ -0,0 +1,113 @@
+#include "OffscreenContext.h"
+#include <stdexcept>
+
+#if defined(_WIN32) || defined(__APPLE__)
+#define OFFSCREEN_CONTEXT_GLFW
+#include <GLFW/glfw3.h>
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+using namespace core;
+
+#ifdef OFFSCREEN_CONTEXT_GLFW
+
+OffscreenContext::OffscreenContext() :
+    _display(NULL),
+    _context(NULL)
+{
+    if(!glfwInit())
+        throw std::runtime_error("glfwInit failed");
+
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "offscreen", NULL, NULL);
+    if(!window) {
+        glfwTerminate();
+        throw std::runtime_error("Creating the hidden offscreen window failed");
+    }
+
+    glfwMakeContextCurrent(window);
+    _context = window;
+}
+
+OffscreenContext::~OffscreenContext() {
+    glfwDestroyWindow((GLFWwindow*)_context);
+    glfwTerminate();
+}
+
+#else
+
+OffscreenContext::OffscreenContext() :
+    _display(NULL),
+    _context(NULL)
+{
+    //prefer the surfaceless platform, it needs neither X11 nor a GPU
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if(display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if(display == EGL_NO_DISPLAY)
+        throw std::runtime_error("No EGL display available");
+
+    EGLint major, minor;
+    if(!eglInitialize(display, &major, &minor))
+        throw std::runtime_error("eglInitialize failed");
+
+    if(!eglBindAPI(EGL_OPENGL_API)) {
+        eglTerminate(display);
+        throw std::runtime_error("EGL does not support desktop OpenGL");
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if(!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+        eglTerminate(display);
+        throw std::runtime_error("No suitable EGL config");
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if(context == EGL_NO_CONTEXT) {
+        eglTerminate(display);
+        throw std::runtime_error("eglCreateContext failed. Can your driver handle OpenGL 3.3?");
+    }
+
+    //no surface at all, everything is drawn into framebuffer objects
+    if(!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        throw std::runtime_error("eglMakeCurrent without a surface failed");
+    }
+
+    _display = display;
+    _context = context;
+}
+
+OffscreenContext::~OffscreenContext() {
+    eglMakeCurrent((EGLDisplay)_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext((EGLDisplay)_display, (EGLContext)_context);
+    eglTerminate((EGLDisplay)_display);
+}
+
+#endif
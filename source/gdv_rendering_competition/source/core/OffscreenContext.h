@@ -0,0 +1,27 @@
+#pragma once
+
+namespace core {
+
+    /**
+     An OpenGL 3.3 core context without a window, made current on construction.
+
+     On Linux this is an EGL context on the surfaceless platform, which runs on machines
+     without a display or GPU (Mesa llvmpipe). Everywhere else it falls back to a hidden
+     GLFW window. There is no default framebuffer to draw into, so render into a Framebuffer.
+     */
+    class OffscreenContext {
+    public:
+
+        OffscreenContext();
+
+        ~OffscreenContext();
+
+    private:
+        void* _display;
+        void* _context;
+
+        //copying disabled
+        OffscreenContext(const OffscreenContext&);
+        const OffscreenContext& operator=(const OffscreenContext&);
+    };
+}
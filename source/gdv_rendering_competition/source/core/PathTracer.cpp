@@ -0,0 +1,320 @@
+#include "PathTracer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+using namespace core;
+
+namespace {
+    const float PI = 3.14159265f;
+
+    //moves the start of the rays off the surface they leave, so they do not hit it again
+    const float SURFACE_OFFSET = 1e-3f;
+
+    //lowbias32 by Chris Wellons, mixes all bits of the input
+    uint32_t Hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+
+    glm::vec4 Unproject(const glm::mat4& inverseCamera, float x, float y, float z) {
+        glm::vec4 p = inverseCamera * glm::vec4(x, y, z, 1.0f);
+        return p / p.w;
+    }
+}
+
+//xorshift32, small and fast enough to be created for every pixel
+class PathTracer::Random {
+public:
+    explicit Random(uint32_t seed) :
+        _state(Hash(seed) | 1U)
+    {
+    }
+
+    //uniform in [0, 1)
+    float next() {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return (float)(_state >> 8) / 16777216.0f;
+    }
+
+private:
+    uint32_t _state;
+};
+
+namespace {
+    //the closest face along a ray, transparent faces are hit with the probability of their alpha
+    class ClosestHit : public VoxelScene::FaceVisitor {
+    public:
+        bool hit;
+        VoxelScene::Face face;
+        glm::vec4 color; //linear texture color of the face
+        bool sorted;     //the faces arrive closest first, so the first hit ends the ray
+
+        ClosestHit(const Shading& shading, PathTracer::Random& random) :
+            hit(false),
+            sorted(false),
+            _shading(shading),
+            _random(random)
+        {
+        }
+
+        bool visit(const VoxelScene::Face& candidate) {
+            if(hit && candidate.distance >= face.distance)
+                return sorted;
+
+            glm::vec4 candidateColor = _shading.sample(candidate.material->textureLayer, candidate.texCoord, 0.0f);
+            if(candidate.material->transparent && _random.next() >= candidateColor.a)
+                return false;
+
+            hit = true;
+            face = candidate;
+            color = candidateColor;
+            return sorted;
+        }
+
+    private:
+        const Shading& _shading;
+        PathTracer::Random& _random;
+    };
+
+    //the product of (1 - alpha) of all faces along a ray, ends at the first opaque face
+    class Transmittance : public VoxelScene::FaceVisitor {
+    public:
+        float value;
+
+        explicit Transmittance(const Shading& shading) :
+            value(1.0f),
+            _shading(shading)
+        {
+        }
+
+        bool visit(const VoxelScene::Face& face) {
+            if(face.material->transparent)
+                value *= 1.0f - _shading.sample(face.material->textureLayer, face.texCoord, 0.0f).a;
+            else
+                value = 0.0f;
+            return value <= 0.0f;
+        }
+
+    private:
+        const Shading& _shading;
+    };
+
+    //a direction around `normal` with a probability proportional to the cosine, for a perfectly diffuse bounce
+    glm::vec3 CosineWeightedDirection(const glm::vec3& normal, float u1, float u2) {
+        glm::vec3 tangent = glm::normalize(glm::cross((std::abs(normal.x) > 0.5f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f), normal));
+        glm::vec3 bitangent = glm::cross(normal, tangent);
+        float radius = std::sqrt(u1);
+        float angle = 2.0f * PI * u2;
+        return tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle)) + normal * std::sqrt(std::max(0.0f, 1.0f - u1));
+    }
+}
+
+PathTracer::PathTracer(int width, int height, ThreadPool& threadPool) :
+    _width(width),
+    _height(height),
+    _threadPool(threadPool),
+    _scene(NULL),
+    _skyColor(0.0f),
+    _samples(0),
+    _rays(0)
+{
+    if(width <= 0 || height <= 0)
+        throw std::runtime_error("PathTracer size must be positive");
+
+    _accumulation.resize((size_t)width * height, glm::vec3(0.0f));
+}
+
+int PathTracer::width() const
+{
+    return _width;
+}
+
+int PathTracer::height() const
+{
+    return _height;
+}
+
+void PathTracer::setTextures(const std::vector<Bitmap>& layers)
+{
+    _shading.setTextures(layers);
+}
+
+void PathTracer::reset(const glm::mat4& camera, const std::vector<Light>& lights, const glm::vec3& skyColor)
+{
+    if(lights.size() > Shading::MAX_LIGHTS)
+        throw std::runtime_error("Too many lights for the path tracer");
+
+    _inverseCamera = glm::inverse(camera);
+    _lights = lights;
+    _skyColor = skyColor;
+    std::fill(_accumulation.begin(), _accumulation.end(), glm::vec3(0.0f));
+    _samples = 0;
+    _rays = 0;
+}
+
+void PathTracer::iterate(const VoxelScene& scene)
+{
+    _scene = &scene;
+    int tilesX = (_width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (_height + TILE_SIZE - 1) / TILE_SIZE;
+    _threadPool.parallelFor((size_t)tilesX * tilesY, [this](size_t tile) {
+        _renderTile((int)tile);
+    });
+    ++_samples;
+}
+
+int PathTracer::sampleCount() const
+{
+    return _samples;
+}
+
+uint64_t PathTracer::rayCount() const
+{
+    return _rays;
+}
+
+Bitmap PathTracer::readPixels() const
+{
+    Bitmap image((unsigned)_width, (unsigned)_height, Bitmap::Format_RGB);
+    unsigned char* pixels = image.pixelBuffer();
+    const float scale = (_samples > 0) ? 1.0f / (float)_samples : 0.0f;
+    const float gamma = 1.0f / 2.2f;
+    for(size_t i = 0; i < _accumulation.size(); ++i) {
+        glm::vec3 linearColor = _accumulation[i] * scale;
+        for(int c = 0; c < 3; ++c) {
+            float value = std::pow(glm::clamp(linearColor[c], 0.0f, 1.0f), gamma);
+            pixels[i * 3 + c] = (unsigned char)(value * 255.0f + 0.5f);
+        }
+    }
+    return image;
+}
+
+void PathTracer::_renderTile(int tile)
+{
+    int tilesX = (_width + TILE_SIZE - 1) / TILE_SIZE;
+    int x0 = (tile % tilesX) * TILE_SIZE;
+    int y0 = (tile / tilesX) * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, _width);
+    int y1 = std::min(y0 + TILE_SIZE, _height);
+
+    uint64_t rays = 0;
+    const uint32_t iterationSeed = Hash((uint32_t)_samples);
+    for(int y = y0; y < y1; ++y) {
+        for(int x = x0; x < x1; ++x) {
+            size_t pixel = (size_t)y * _width + x;
+            Random random((uint32_t)pixel ^ iterationSeed);
+
+            //a random point inside the pixel, the average over many of them is antialiased
+            float ndcX = ((float)x + random.next()) / (float)_width * 2.0f - 1.0f;
+            float ndcY = 1.0f - ((float)y + random.next()) / (float)_height * 2.0f;
+            glm::vec3 nearPoint(Unproject(_inverseCamera, ndcX, ndcY, -1.0f));
+            glm::vec3 farPoint(Unproject(_inverseCamera, ndcX, ndcY, 1.0f));
+            float length = glm::length(farPoint - nearPoint);
+
+            glm::vec3 sample = _tracePath(nearPoint, (farPoint - nearPoint) / length, length, random, rays);
+            if(std::isfinite(sample.x) && std::isfinite(sample.y) && std::isfinite(sample.z))
+                _accumulation[pixel] += sample;
+        }
+    }
+    _rays += rays;
+}
+
+glm::vec3 PathTracer::_tracePath(glm::vec3 origin, glm::vec3 direction, float maxDistance, Random& random, uint64_t& rays) const
+{
+    glm::vec3 radiance(0.0f);
+    glm::vec3 throughput(1.0f);
+    for(int bounce = 0; bounce < MAX_BOUNCES; ++bounce) {
+        //the boxes first, the closest hit among them shortens the walk through the blocks
+        ClosestHit hit(_shading, random);
+        _scene->traceBoxes(origin, direction, maxDistance, hit);
+        hit.sorted = true;
+        _scene->traceBlocks(origin, direction, hit.hit ? hit.face.distance : maxDistance, hit);
+        ++rays;
+
+        if(!hit.hit) {
+            radiance += throughput * _skyColor;
+            break;
+        }
+
+        //both sides of a face are lit, like the inside of the car's boxes in Render()
+        glm::vec3 position = origin + direction * hit.face.distance;
+        glm::vec3 normal = hit.face.normal;
+        if(glm::dot(normal, direction) > 0.0f)
+            normal = -normal;
+        glm::vec3 albedo(hit.color);
+
+        radiance += throughput * _directLight(*hit.face.material, albedo, position, normal, -direction, rays);
+
+        //the diffuse bounce, Russian roulette ends the paths that carry little light
+        throughput *= albedo;
+        if(bounce >= 2) {
+            float survival = std::min(std::max(throughput.r, std::max(throughput.g, throughput.b)), 0.95f);
+            if(random.next() >= survival)
+                break;
+            throughput /= survival;
+        }
+
+        float u1 = random.next();
+        float u2 = random.next();
+        origin = position + normal * SURFACE_OFFSET;
+        direction = CosineWeightedDirection(normal, u1, u2);
+        maxDistance = FLT_MAX;
+    }
+    return radiance;
+}
+
+glm::vec3 PathTracer::_directLight(const Shading::Material& material, const glm::vec3& albedo, const glm::vec3& position,
+                                   const glm::vec3& normal, const glm::vec3& toViewer, uint64_t& rays) const
+{
+    //ApplyLight() of fragment-shader.txt for every light, without the ambient term but with shadows
+    glm::vec3 result(0.0f);
+    const glm::vec3 origin = position + normal * SURFACE_OFFSET;
+    for(size_t i = 0; i < _lights.size(); ++i) {
+        const Light& light = _lights[i];
+        glm::vec3 surfaceToLight;
+        float attenuation = 1.0f;
+        float distanceToLight = FLT_MAX;
+        if(light.position.w == 0.0f) {
+            surfaceToLight = glm::normalize(glm::vec3(light.position));
+        } else {
+            glm::vec3 toLight = glm::vec3(light.position) - position;
+            distanceToLight = glm::length(toLight);
+            surfaceToLight = toLight / distanceToLight;
+            attenuation = 1.0f / (1.0f + light.attenuation * distanceToLight * distanceToLight);
+            if(glm::dot(-surfaceToLight, light.coneDirection) < light.coneCosine)
+                continue;
+        }
+
+        float diffuseCoefficient = glm::dot(normal, surfaceToLight);
+        if(diffuseCoefficient <= 0.0f)
+            continue;
+
+        ++rays;
+        float visibility = _transmittance(origin, surfaceToLight, distanceToLight);
+        if(visibility <= 0.0f)
+            continue;
+
+        float specularCoefficient = std::pow(std::max(0.0f, glm::dot(toViewer, glm::reflect(-surfaceToLight, normal))), material.shininess);
+        glm::vec3 diffuse = diffuseCoefficient * albedo * light.intensities;
+        glm::vec3 specular = specularCoefficient * material.specularColor * light.intensities;
+        result += visibility * attenuation * (diffuse + specular);
+    }
+    return result;
+}
+
+float PathTracer::_transmittance(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+{
+    Transmittance transmittance(_shading);
+    _scene->traceBoxes(origin, direction, maxDistance, transmittance);
+    if(transmittance.value > 0.0f)
+        _scene->traceBlocks(origin, direction, maxDistance, transmittance);
+    return transmittance.value;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "Bitmap.h"
+#include "Shading.h"
+#include "ThreadPool.h"
+#include "VoxelScene.h"
+
+namespace core {
+
+    /**
+     Renders reference images of a VoxelScene with a progressive path tracer.
+     Every iteration adds one sample to every pixel of an accumulation buffer,
+     so the image gets less noisy the longer it runs. It is meant for offline
+     comparisons, not for frames in real time.
+
+     The lights work like ApplyLight() of fragment-shader.txt: spot cones,
+     attenuation, directional lights and the Phong highlight. They are sampled
+     at every bounce and cast shadows. Instead of the ambient term of the shader
+     the light bounces off the surfaces (perfectly diffuse) and comes from the
+     sky where a path leaves the scene. Transparent surfaces are hit with the
+     probability of their alpha and let the rest of the light through.
+
+     The image is split into tiles that the threads of the pool take one at a
+     time. Every pixel and iteration has its own random numbers, so the image
+     does not depend on the number of threads.
+     */
+    class PathTracer {
+    public:
+        typedef Shading::Light Light;
+
+        static const int TILE_SIZE = 16;
+        static const int MAX_BOUNCES = 6;
+
+        PathTracer(int width, int height, ThreadPool& threadPool);
+
+        int width() const;
+
+        int height() const;
+
+        /**
+         Sets the texture layers the materials refer to, see Shading::setTextures().
+         */
+        void setTextures(const std::vector<Bitmap>& layers);
+
+        /**
+         Starts a new image and throws the accumulated samples away. `camera` is the
+         projection and view matrix, `skyColor` the linear color of the light that
+         comes from outside the scene.
+         */
+        void reset(const glm::mat4& camera, const std::vector<Light>& lights, const glm::vec3& skyColor);
+
+        /**
+         Adds one sample to every pixel.
+         */
+        void iterate(const VoxelScene& scene);
+
+        /**
+         @return the number of samples per pixel since reset()
+         */
+        int sampleCount() const;
+
+        /**
+         @return the number of rays traced since reset(), from the camera, bounces and to the lights
+         */
+        uint64_t rayCount() const;
+
+        /**
+         The average of the samples so far, gamma corrected, RGB with the top row first
+         like Framebuffer::readPixels().
+         */
+        Bitmap readPixels() const;
+
+        //the random numbers of one pixel in one iteration, only used inside PathTracer.cpp
+        class Random;
+
+    private:
+        int _width;
+        int _height;
+        ThreadPool& _threadPool;
+
+        Shading _shading;
+        const VoxelScene* _scene;
+
+        glm::mat4 _inverseCamera;
+        std::vector<Light> _lights;
+        glm::vec3 _skyColor;
+
+        std::vector<glm::vec3> _accumulation; //the sum of the linear samples of every pixel
+        int _samples;
+        std::atomic<uint64_t> _rays;
+
+        void _renderTile(int tile);
+        glm::vec3 _tracePath(glm::vec3 origin, glm::vec3 direction, float maxDistance, Random& random, uint64_t& rays) const;
+
+        //the light that reaches `position` directly from all lights and is reflected towards `toViewer`
+        glm::vec3 _directLight(const Shading::Material& material, const glm::vec3& albedo, const glm::vec3& position,
+                               const glm::vec3& normal, const glm::vec3& toViewer, uint64_t& rays) const;
+
+        //how much light gets from `origin` to `maxDistance` along the ray, 0 if something opaque is in the way
+        float _transmittance(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+        //copying disabled
+        PathTracer(const PathTracer&);
+        const PathTracer& operator=(const PathTracer&);
+    };
+}
@@ -0,0 +1,212 @@
+#include "Profiler.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+using namespace core;
+
+Profiler::Scope::Scope(Profiler& profiler, const char* name, const char* traceDetail) :
+    _profiler(profiler),
+    _name(name),
+    _traceDetail(traceDetail),
+    _start(std::chrono::steady_clock::now())
+{
+}
+
+Profiler::Scope::~Scope()
+{
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - _start;
+    _profiler.addCpuTime(_name, elapsed.count());
+    Trace::record(_name, _start, end, _traceDetail);
+}
+
+Profiler::GpuScope::GpuScope(Profiler& profiler, const char* name) :
+    _profiler(profiler)
+{
+    _profiler._beginQuery(name);
+}
+
+Profiler::GpuScope::~GpuScope()
+{
+    _profiler._endQuery();
+}
+
+Profiler::Profiler() :
+    _inFrame(false),
+    _frame(0),
+    _gpuScopeOpen(false)
+{
+}
+
+void Profiler::deleteQueries()
+{
+    assert(!_gpuScopeOpen);
+    for(size_t i = 0; i < GPU_LATENCY; ++i) {
+        for(size_t q = 0; q < _pending[i].size(); ++q)
+            _freeQueries.push_back(_pending[i][q].query);
+        _pending[i].clear();
+    }
+    if(!_freeQueries.empty())
+        glDeleteQueries((GLsizei)_freeQueries.size(), &_freeQueries[0]);
+    _freeQueries.clear();
+}
+
+void Profiler::beginFrame()
+{
+    assert(!_inFrame);
+    _inFrame = true;
+
+    //the queries of this slot were issued GPU_LATENCY frames ago
+    _collect(_pending[_frame % GPU_LATENCY]);
+}
+
+void Profiler::endFrame()
+{
+    assert(_inFrame && !_gpuScopeOpen);
+    for(size_t i = 0; i < _sections.size(); ++i) {
+        Section& section = _sections[i];
+        if(section.touched && !section.gpu)
+            _push(section, section.frameTotal);
+        section.frameTotal = 0.0;
+        section.touched = false;
+    }
+    _inFrame = false;
+    ++_frame;
+}
+
+void Profiler::addCpuTime(const char* name, double milliseconds)
+{
+    _add(_section(name, false), milliseconds);
+}
+
+bool Profiler::stats(const std::string& name, bool gpu, Stats& stats) const
+{
+    for(size_t i = 0; i < _sections.size(); ++i) {
+        const Section& section = _sections[i];
+        if(section.gpu != gpu || section.name != name)
+            continue;
+
+        size_t count = (section.sampleCount < HISTORY) ? section.sampleCount : HISTORY;
+        if(count == 0)
+            return false;
+
+        std::vector<float> sorted(section.samples.begin(), section.samples.begin() + count);
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for(size_t s = 0; s < count; ++s)
+            sum += sorted[s];
+
+        //nearest rank, the smallest sample that is not below 99% of all samples
+        size_t rank = (count * 99 + 99) / 100;
+        stats.samples = count;
+        stats.min = sorted.front();
+        stats.avg = sum / (double)count;
+        stats.p99 = sorted[rank - 1];
+        stats.max = sorted.back();
+        return true;
+    }
+    return false;
+}
+
+void Profiler::print(std::ostream& out) const
+{
+    char line[160];
+    snprintf(line, sizeof(line), "%-28s %7s %9s %9s %9s %9s", "section (ms)", "samples", "min", "avg", "p99", "max");
+    out << line << std::endl;
+    for(size_t i = 0; i < _sections.size(); ++i) {
+        const Section& section = _sections[i];
+        Stats s;
+        if(!stats(section.name, section.gpu, s))
+            continue;
+
+        std::string label = (section.gpu ? "GPU " : "CPU ") + section.name;
+        snprintf(line, sizeof(line), "%-28s %7u %9.3f %9.3f %9.3f %9.3f",
+                 label.c_str(), (unsigned)s.samples, s.min, s.avg, s.p99, s.max);
+        out << line << std::endl;
+    }
+}
+
+size_t Profiler::_section(const char* name, bool gpu)
+{
+    for(size_t i = 0; i < _sections.size(); ++i) {
+        if(_sections[i].gpu == gpu && _sections[i].name == name)
+            return i;
+    }
+
+    Section section;
+    section.name = name;
+    section.gpu = gpu;
+    section.samples.resize(HISTORY, 0.0f);
+    section.sampleCount = 0;
+    section.frameTotal = 0.0;
+    section.touched = false;
+    _sections.push_back(section);
+    return _sections.size() - 1;
+}
+
+void Profiler::_add(size_t index, double milliseconds)
+{
+    Section& section = _sections[index];
+    if(!_inFrame) {
+        _push(section, milliseconds);
+        return;
+    }
+    section.frameTotal += milliseconds;
+    section.touched = true;
+}
+
+void Profiler::_push(Section& section, double milliseconds)
+{
+    section.samples[section.sampleCount % HISTORY] = (float)milliseconds;
+    ++section.sampleCount;
+}
+
+void Profiler::_beginQuery(const char* name)
+{
+    assert(!_gpuScopeOpen);
+    _gpuScopeOpen = true;
+
+    PendingQuery pending;
+    pending.section = _section(name, true);
+    if(_freeQueries.empty()) {
+        glGenQueries(1, &pending.query);
+    } else {
+        pending.query = _freeQueries.back();
+        _freeQueries.pop_back();
+    }
+    glBeginQuery(GL_TIME_ELAPSED, pending.query);
+    _pending[_frame % GPU_LATENCY].push_back(pending);
+}
+
+void Profiler::_endQuery()
+{
+    assert(_gpuScopeOpen);
+    glEndQuery(GL_TIME_ELAPSED);
+    _gpuScopeOpen = false;
+}
+
+void Profiler::_collect(std::vector<PendingQuery>& pending)
+{
+    //several scopes with the same name in one frame become one sample, like on the CPU
+    for(size_t q = 0; q < pending.size(); ++q) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(pending[q].query, GL_QUERY_RESULT, &nanoseconds);
+        Section& section = _sections[pending[q].section];
+        section.frameTotal += (double)nanoseconds / 1.0e6;
+        section.touched = true;
+        _freeQueries.push_back(pending[q].query);
+    }
+    pending.clear();
+
+    for(size_t i = 0; i < _sections.size(); ++i) {
+        Section& section = _sections[i];
+        if(section.gpu && section.touched)
+            _push(section, section.frameTotal);
+        if(section.gpu) {
+            section.frameTotal = 0.0;
+            section.touched = false;
+        }
+    }
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace core {
+
+    /**
+     Collects CPU and GPU timings per named section and keeps the last HISTORY
+     frames of every section, so rolling statistics can be printed.
+
+     Sections are measured with the Scope and GpuScope helpers. All scopes with the
+     same name that close during one frame (between beginFrame() and endFrame()) are
+     added up into a single sample. Scopes outside of a frame, e.g. while loading,
+     are stored as one sample each.
+
+     GPU times come from GL_TIME_ELAPSED queries. The results are read back
+     GPU_LATENCY frames later so the CPU rarely has to wait for the GPU. Only one GpuScope
+     can be open at a time, the queries of this type can't be nested.
+
+     The profiler is usually a global, so it does not touch GL in its destructor,
+     see deleteQueries(). It is meant to be used from the main thread only.
+     */
+    class Profiler {
+    public:
+        static const size_t HISTORY = 240;     //frames of samples per section
+        static const size_t GPU_LATENCY = 4;   //frames until a GPU query is read back
+
+        //measures the CPU time until it goes out of scope, and adds it to the Trace if that is enabled
+        class Scope {
+        public:
+            Scope(Profiler& profiler, const char* name, const char* traceDetail = NULL);
+            ~Scope();
+
+        private:
+            Profiler& _profiler;
+            const char* _name;
+            const char* _traceDetail;
+            std::chrono::steady_clock::time_point _start;
+
+            //copying disabled
+            Scope(const Scope&);
+            const Scope& operator=(const Scope&);
+        };
+
+        //measures the GPU time of the commands issued until it goes out of scope
+        class GpuScope {
+        public:
+            GpuScope(Profiler& profiler, const char* name);
+            ~GpuScope();
+
+        private:
+            Profiler& _profiler;
+
+            //copying disabled
+            GpuScope(const GpuScope&);
+            const GpuScope& operator=(const GpuScope&);
+        };
+
+        struct Stats {
+            size_t samples;
+            double min;     //milliseconds
+            double avg;
+            double p99;
+            double max;
+        };
+
+        Profiler();
+
+        /**
+         Deletes the GL query objects, must be called while the GL context still exists.
+         Profiling can go on afterwards, new queries are created when needed.
+         */
+        void deleteQueries();
+
+        void beginFrame();
+        void endFrame();
+
+        /**
+         Adds `milliseconds` to the CPU section `name`, for times measured elsewhere.
+         */
+        void addCpuTime(const char* name, double milliseconds);
+
+        /**
+         @return false if there is no section with this name or it has no samples yet
+         */
+        bool stats(const std::string& name, bool gpu, Stats& stats) const;
+
+        /**
+         Prints min/avg/p99/max of every section, one line each.
+         */
+        void print(std::ostream& out) const;
+
+    private:
+        struct Section {
+            std::string name;
+            bool gpu;
+            std::vector<float> samples; //ring buffer with HISTORY entries
+            size_t sampleCount;         //samples ever added
+            double frameTotal;          //accumulated during the current frame
+            bool touched;               //frameTotal has to be pushed at the end of the frame
+        };
+
+        struct PendingQuery {
+            size_t section;
+            GLuint query;
+        };
+
+        std::vector<Section> _sections;
+        bool _inFrame;
+        size_t _frame;
+
+        //query objects of the last GPU_LATENCY frames, reused round robin
+        std::vector<PendingQuery> _pending[GPU_LATENCY];
+        std::vector<GLuint> _freeQueries;
+        bool _gpuScopeOpen;
+
+        size_t _section(const char* name, bool gpu);
+        void _add(size_t section, double milliseconds);
+        void _push(Section& section, double milliseconds);
+        void _beginQuery(const char* name);
+        void _endQuery();
+        void _collect(std::vector<PendingQuery>& pending);
+
+        //copying disabled
+        Profiler(const Profiler&);
+        const Profiler& operator=(const Profiler&);
+    };
+}
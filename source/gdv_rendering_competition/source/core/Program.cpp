@@ -1,9 +1,77 @@
 #include "Program.h"
 #include <stdexcept>
+#include <cstring>
+#include <sstream>
 #include <glm/gtc/type_ptr.hpp>
 
 using namespace core;
 
+//FNV-1a
+static size_t HashName(const GLchar* name) {
+    size_t hash = 2166136261u;
+    for(const GLchar* c = name; *c; ++c)
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    return hash;
+}
+
+Program::LocationTable::LocationTable() :
+    _count(0)
+{
+}
+
+void Program::LocationTable::insert(const std::string& name, GLint location) {
+    if((_count + 1) * 2 > _entries.size())
+        _grow();
+
+    size_t hash = HashName(name.c_str());
+    size_t mask = _entries.size() - 1;
+    for(size_t i = hash & mask; ; i = (i + 1) & mask) {
+        Entry& entry = _entries[i];
+        if(entry.location == -1) {
+            entry.name = name;
+            entry.hash = hash;
+            entry.location = location;
+            ++_count;
+            return;
+        }
+        if(entry.hash == hash && entry.name == name) {
+            entry.location = location;
+            return;
+        }
+    }
+}
+
+GLint Program::LocationTable::find(const GLchar* name) const {
+    if(_entries.empty())
+        return -1;
+
+    size_t hash = HashName(name);
+    size_t mask = _entries.size() - 1;
+    for(size_t i = hash & mask; ; i = (i + 1) & mask) {
+        const Entry& entry = _entries[i];
+        if(entry.location == -1)
+            return -1;
+        if(entry.hash == hash && strcmp(entry.name.c_str(), name) == 0)
+            return entry.location;
+    }
+}
+
+void Program::LocationTable::_grow() {
+    std::vector<Entry> old;
+    old.swap(_entries);
+
+    Entry empty;
+    empty.hash = 0;
+    empty.location = -1;
+    _entries.assign(old.empty() ? 16 : old.size() * 2, empty);
+    _count = 0;
+
+    for(size_t i = 0; i < old.size(); ++i) {
+        if(old[i].location != -1)
+            insert(old[i].name, old[i].location);
+    }
+}
+
 Program::Program(const std::vector<Shader>& shaders) :
     _object(0)
 {
@@ -37,6 +105,52 @@ Program::Program(const std::vector<Shader>& shaders) :
         glDeleteProgram(_object); _object = 0;
         throw std::runtime_error(msg);
     }
+
+    _cacheLocations();
+}
+
+void Program::_cacheLocations() {
+    GLint count = 0;
+    GLint maxLength = 0;
+    GLint size = 0;
+    GLenum type = 0;
+
+    glGetProgramiv(_object, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(_object, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<GLchar> nameBuffer(maxLength + 1);
+    for(GLint i = 0; i < count; ++i) {
+        glGetActiveUniform(_object, (GLuint)i, (GLsizei)nameBuffer.size(), NULL, &size, &type, &nameBuffer[0]);
+        std::string name(&nameBuffer[0]);
+        GLint location = glGetUniformLocation(_object, name.c_str());
+        if(location == -1)
+            continue; //member of a uniform block, those have no location
+
+        _uniforms.insert(name, location);
+
+        //arrays are reported as "name[0]", but may also be addressed as "name" and "name[i]"
+        size_t bracket = name.rfind("[0]");
+        if(bracket != std::string::npos && bracket + 3 == name.size()) {
+            std::string baseName = name.substr(0, bracket);
+            _uniforms.insert(baseName, location);
+            for(GLint element = 1; element < size; ++element) {
+                std::ostringstream elementName;
+                elementName << baseName << "[" << element << "]";
+                GLint elementLocation = glGetUniformLocation(_object, elementName.str().c_str());
+                if(elementLocation != -1)
+                    _uniforms.insert(elementName.str(), elementLocation);
+            }
+        }
+    }
+
+    glGetProgramiv(_object, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(_object, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+    nameBuffer.assign(maxLength + 1, 0);
+    for(GLint i = 0; i < count; ++i) {
+        glGetActiveAttrib(_object, (GLuint)i, (GLsizei)nameBuffer.size(), NULL, &size, &type, &nameBuffer[0]);
+        GLint location = glGetAttribLocation(_object, &nameBuffer[0]);
+        if(location != -1) //built-ins like gl_VertexID have no location
+            _attribs.insert(&nameBuffer[0], location);
+    }
 }
 
 Program::~Program() {
@@ -66,7 +180,7 @@ GLint Program::attrib(const GLchar* attribName) const {
     if(!attribName)
         throw std::runtime_error("attribName was NULL");
     
-    GLint attrib = glGetAttribLocation(_object, attribName);
+    GLint attrib = _attribs.find(attribName);
     if(attrib == -1)
         throw std::runtime_error(std::string("Program attribute not found: ") + attribName);
     
@@ -77,13 +191,28 @@ GLint Program::uniform(const GLchar* uniformName) const {
     if(!uniformName)
         throw std::runtime_error("uniformName was NULL");
     
-    GLint uniform = glGetUniformLocation(_object, uniformName);
+    GLint uniform = _uniforms.find(uniformName);
     if(uniform == -1)
         throw std::runtime_error(std::string("Program uniform not found: ") + uniformName);
     
     return uniform;
 }
 
+UniformHandle Program::uniformHandle(const GLchar* uniformName) const {
+    return UniformHandle(uniform(uniformName));
+}
+
+void Program::bindUniformBlock(const GLchar* blockName, GLuint bindingPoint) {
+    if(!blockName)
+        throw std::runtime_error("blockName was NULL");
+
+    GLuint blockIndex = glGetUniformBlockIndex(_object, blockName);
+    if(blockIndex == GL_INVALID_INDEX)
+        throw std::runtime_error(std::string("Program uniform block not found: ") + blockName);
+
+    glUniformBlockBinding(_object, blockIndex, bindingPoint);
+}
+
 #define ATTRIB_N_UNIFORM_SETTERS(OGL_TYPE, TYPE_PREFIX, TYPE_SUFFIX) \
 \
     void Program::setAttrib(const GLchar* name, OGL_TYPE v0) \
@@ -103,66 +232,116 @@ GLint Program::uniform(const GLchar* uniformName) const {
         { assert(isInUse()); glVertexAttrib ## TYPE_PREFIX ## 3 ## TYPE_SUFFIX ## v (attrib(name), v); } \
     void Program::setAttrib4v(const GLchar* name, const OGL_TYPE* v) \
         { assert(isInUse()); glVertexAttrib ## TYPE_PREFIX ## 4 ## TYPE_SUFFIX ## v (attrib(name), v); } \
+\
+    void Program::setUniform(UniformHandle u, OGL_TYPE v0) \
+        { assert(isInUse()); glUniform1 ## TYPE_SUFFIX (u.location, v0); } \
+    void Program::setUniform(UniformHandle u, OGL_TYPE v0, OGL_TYPE v1) \
+        { assert(isInUse()); glUniform2 ## TYPE_SUFFIX (u.location, v0, v1); } \
+    void Program::setUniform(UniformHandle u, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2) \
+        { assert(isInUse()); glUniform3 ## TYPE_SUFFIX (u.location, v0, v1, v2); } \
+    void Program::setUniform(UniformHandle u, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2, OGL_TYPE v3) \
+        { assert(isInUse()); glUniform4 ## TYPE_SUFFIX (u.location, v0, v1, v2, v3); } \
+\
+    void Program::setUniform1v(UniformHandle u, const OGL_TYPE* v, GLsizei count) \
+        { assert(isInUse()); glUniform1 ## TYPE_SUFFIX ## v (u.location, count, v); } \
+    void Program::setUniform2v(UniformHandle u, const OGL_TYPE* v, GLsizei count) \
+        { assert(isInUse()); glUniform2 ## TYPE_SUFFIX ## v (u.location, count, v); } \
+    void Program::setUniform3v(UniformHandle u, const OGL_TYPE* v, GLsizei count) \
+        { assert(isInUse()); glUniform3 ## TYPE_SUFFIX ## v (u.location, count, v); } \
+    void Program::setUniform4v(UniformHandle u, const OGL_TYPE* v, GLsizei count) \
+        { assert(isInUse()); glUniform4 ## TYPE_SUFFIX ## v (u.location, count, v); } \
 \
     void Program::setUniform(const GLchar* name, OGL_TYPE v0) \
-        { assert(isInUse()); glUniform1 ## TYPE_SUFFIX (uniform(name), v0); } \
+        { setUniform(uniformHandle(name), v0); } \
     void Program::setUniform(const GLchar* name, OGL_TYPE v0, OGL_TYPE v1) \
-        { assert(isInUse()); glUniform2 ## TYPE_SUFFIX (uniform(name), v0, v1); } \
+        { setUniform(uniformHandle(name), v0, v1); } \
     void Program::setUniform(const GLchar* name, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2) \
-        { assert(isInUse()); glUniform3 ## TYPE_SUFFIX (uniform(name), v0, v1, v2); } \
+        { setUniform(uniformHandle(name), v0, v1, v2); } \
     void Program::setUniform(const GLchar* name, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2, OGL_TYPE v3) \
-        { assert(isInUse()); glUniform4 ## TYPE_SUFFIX (uniform(name), v0, v1, v2, v3); } \
+        { setUniform(uniformHandle(name), v0, v1, v2, v3); } \
 \
     void Program::setUniform1v(const GLchar* name, const OGL_TYPE* v, GLsizei count) \
-        { assert(isInUse()); glUniform1 ## TYPE_SUFFIX ## v (uniform(name), count, v); } \
+        { setUniform1v(uniformHandle(name), v, count); } \
     void Program::setUniform2v(const GLchar* name, const OGL_TYPE* v, GLsizei count) \
-        { assert(isInUse()); glUniform2 ## TYPE_SUFFIX ## v (uniform(name), count, v); } \
+        { setUniform2v(uniformHandle(name), v, count); } \
     void Program::setUniform3v(const GLchar* name, const OGL_TYPE* v, GLsizei count) \
-        { assert(isInUse()); glUniform3 ## TYPE_SUFFIX ## v (uniform(name), count, v); } \
+        { setUniform3v(uniformHandle(name), v, count); } \
     void Program::setUniform4v(const GLchar* name, const OGL_TYPE* v, GLsizei count) \
-        { assert(isInUse()); glUniform4 ## TYPE_SUFFIX ## v (uniform(name), count, v); }
+        { setUniform4v(uniformHandle(name), v, count); }
 
 ATTRIB_N_UNIFORM_SETTERS(GLfloat, , f);
 ATTRIB_N_UNIFORM_SETTERS(GLdouble, , d);
 ATTRIB_N_UNIFORM_SETTERS(GLint, I, i);
 ATTRIB_N_UNIFORM_SETTERS(GLuint, I, ui);
 
-void Program::setUniformMatrix2(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose) {
+void Program::setUniformMatrix2(UniformHandle u, const GLfloat* v, GLsizei count, GLboolean transpose) {
     assert(isInUse());
-    glUniformMatrix2fv(uniform(name), count, transpose, v);
+    glUniformMatrix2fv(u.location, count, transpose, v);
 }
 
-void Program::setUniformMatrix3(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose) {
+void Program::setUniformMatrix3(UniformHandle u, const GLfloat* v, GLsizei count, GLboolean transpose) {
     assert(isInUse());
-    glUniformMatrix3fv(uniform(name), count, transpose, v);
+    glUniformMatrix3fv(u.location, count, transpose, v);
 }
 
-void Program::setUniformMatrix4(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose) {
+void Program::setUniformMatrix4(UniformHandle u, const GLfloat* v, GLsizei count, GLboolean transpose) {
     assert(isInUse());
-    glUniformMatrix4fv(uniform(name), count, transpose, v);
+    glUniformMatrix4fv(u.location, count, transpose, v);
 }
 
-void Program::setUniform(const GLchar* name, const glm::mat2& m, GLboolean transpose) {
+void Program::setUniform(UniformHandle u, const glm::mat2& m, GLboolean transpose) {
     assert(isInUse());
-    glUniformMatrix2fv(uniform(name), 1, transpose, glm::value_ptr(m));
+    glUniformMatrix2fv(u.location, 1, transpose, glm::value_ptr(m));
 }
 
-void Program::setUniform(const GLchar* name, const glm::mat3& m, GLboolean transpose) {
+void Program::setUniform(UniformHandle u, const glm::mat3& m, GLboolean transpose) {
     assert(isInUse());
-    glUniformMatrix3fv(uniform(name), 1, transpose, glm::value_ptr(m));
+    glUniformMatrix3fv(u.location, 1, transpose, glm::value_ptr(m));
 }
 
-void Program::setUniform(const GLchar* name, const glm::mat4& m, GLboolean transpose) {
+void Program::setUniform(UniformHandle u, const glm::mat4& m, GLboolean transpose) {
     assert(isInUse());
-    glUniformMatrix4fv(uniform(name), 1, transpose, glm::value_ptr(m));
+    glUniformMatrix4fv(u.location, 1, transpose, glm::value_ptr(m));
+}
+
+void Program::setUniform(UniformHandle u, const glm::vec3& v) {
+    setUniform3v(u, glm::value_ptr(v));
+}
+
+void Program::setUniform(UniformHandle u, const glm::vec4& v) {
+    setUniform4v(u, glm::value_ptr(v));
+}
+
+void Program::setUniformMatrix2(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose) {
+    setUniformMatrix2(uniformHandle(name), v, count, transpose);
+}
+
+void Program::setUniformMatrix3(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose) {
+    setUniformMatrix3(uniformHandle(name), v, count, transpose);
+}
+
+void Program::setUniformMatrix4(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose) {
+    setUniformMatrix4(uniformHandle(name), v, count, transpose);
+}
+
+void Program::setUniform(const GLchar* name, const glm::mat2& m, GLboolean transpose) {
+    setUniform(uniformHandle(name), m, transpose);
+}
+
+void Program::setUniform(const GLchar* name, const glm::mat3& m, GLboolean transpose) {
+    setUniform(uniformHandle(name), m, transpose);
+}
+
+void Program::setUniform(const GLchar* name, const glm::mat4& m, GLboolean transpose) {
+    setUniform(uniformHandle(name), m, transpose);
 }
 
 void Program::setUniform(const GLchar* uniformName, const glm::vec3& v) {
-    setUniform3v(uniformName, glm::value_ptr(v));
+    setUniform(uniformHandle(uniformName), v);
 }
 
 void Program::setUniform(const GLchar* uniformName, const glm::vec4& v) {
-    setUniform4v(uniformName, glm::value_ptr(v));
+    setUniform(uniformHandle(uniformName), v);
 }
 
 
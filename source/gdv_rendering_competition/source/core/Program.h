@@ -2,10 +2,22 @@
 
 #include "Shader.h"
 #include <vector>
+#include <string>
 #include <glm/glm.hpp>
 
 namespace core {
 
+    /**
+     A uniform location resolved once with Program::uniformHandle(). Setting a uniform
+     through a handle skips the name lookup entirely.
+     */
+    struct UniformHandle {
+        GLint location;
+
+        UniformHandle() : location(-1) {}
+        explicit UniformHandle(GLint location) : location(location) {}
+    };
+
     class Program { 
     public:
 
@@ -24,6 +36,10 @@ namespace core {
 
         GLint uniform(const GLchar* uniformName) const;
 
+        UniformHandle uniformHandle(const GLchar* uniformName) const;
+
+        void bindUniformBlock(const GLchar* blockName, GLuint bindingPoint);
+
 #define _TDOGL_PROGRAM_ATTRIB_N_UNIFORM_SETTERS(OGL_TYPE) \
         void setAttrib(const GLchar* attribName, OGL_TYPE v0); \
         void setAttrib(const GLchar* attribName, OGL_TYPE v0, OGL_TYPE v1); \
@@ -44,6 +60,16 @@ namespace core {
         void setUniform2v(const GLchar* uniformName, const OGL_TYPE* v, GLsizei count=1); \
         void setUniform3v(const GLchar* uniformName, const OGL_TYPE* v, GLsizei count=1); \
         void setUniform4v(const GLchar* uniformName, const OGL_TYPE* v, GLsizei count=1); \
+\
+        void setUniform(UniformHandle uniform, OGL_TYPE v0); \
+        void setUniform(UniformHandle uniform, OGL_TYPE v0, OGL_TYPE v1); \
+        void setUniform(UniformHandle uniform, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2); \
+        void setUniform(UniformHandle uniform, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2, OGL_TYPE v3); \
+\
+        void setUniform1v(UniformHandle uniform, const OGL_TYPE* v, GLsizei count=1); \
+        void setUniform2v(UniformHandle uniform, const OGL_TYPE* v, GLsizei count=1); \
+        void setUniform3v(UniformHandle uniform, const OGL_TYPE* v, GLsizei count=1); \
+        void setUniform4v(UniformHandle uniform, const OGL_TYPE* v, GLsizei count=1); \
 
         _TDOGL_PROGRAM_ATTRIB_N_UNIFORM_SETTERS(GLfloat)
         _TDOGL_PROGRAM_ATTRIB_N_UNIFORM_SETTERS(GLdouble)
@@ -59,9 +85,44 @@ namespace core {
         void setUniform(const GLchar* uniformName, const glm::vec3& v);
         void setUniform(const GLchar* uniformName, const glm::vec4& v);
 
+        void setUniformMatrix2(UniformHandle uniform, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
+        void setUniformMatrix3(UniformHandle uniform, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
+        void setUniformMatrix4(UniformHandle uniform, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
+        void setUniform(UniformHandle uniform, const glm::mat2& m, GLboolean transpose=GL_FALSE);
+        void setUniform(UniformHandle uniform, const glm::mat3& m, GLboolean transpose=GL_FALSE);
+        void setUniform(UniformHandle uniform, const glm::mat4& m, GLboolean transpose=GL_FALSE);
+        void setUniform(UniformHandle uniform, const glm::vec3& v);
+        void setUniform(UniformHandle uniform, const glm::vec4& v);
+
         
     private:
+        /**
+         Open addressing hash table from names to locations, filled once after linking
+         so that name based lookups never have to ask the driver.
+         */
+        class LocationTable {
+        public:
+            LocationTable();
+            void insert(const std::string& name, GLint location);
+            GLint find(const GLchar* name) const; //-1 if not found
+
+        private:
+            struct Entry {
+                std::string name;
+                size_t hash;
+                GLint location;
+            };
+            std::vector<Entry> _entries;
+            size_t _count;
+
+            void _grow();
+        };
+
         GLuint _object;
+        LocationTable _uniforms;
+        LocationTable _attribs;
+
+        void _cacheLocations();
         
         //copying disabled
         Program(const Program&);
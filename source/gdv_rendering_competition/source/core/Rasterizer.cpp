@@ -0,0 +1,375 @@
+#include "Rasterizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RASTERIZER_SSE2
+#endif
+
+using namespace core;
+
+namespace {
+    uint32_t PackColor(const glm::vec3& color, float alpha) {
+        glm::vec3 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+        uint32_t a = (uint32_t)(glm::clamp(alpha, 0.0f, 1.0f) * 255.0f + 0.5f);
+        return (uint32_t)c.r | ((uint32_t)c.g << 8) | ((uint32_t)c.b << 16) | (a << 24);
+    }
+
+    glm::vec3 UnpackColor(uint32_t color) {
+        return glm::vec3((float)(color & 0xff), (float)((color >> 8) & 0xff), (float)((color >> 16) & 0xff)) / 255.0f;
+    }
+
+    const uint32_t NO_TRIANGLE = 0xffffffff;
+
+    //a clip space vertex with everything that is interpolated, for clipping against the near plane
+    struct ClipVertex {
+        glm::vec4 clip;
+        glm::vec3 world;
+        glm::vec3 normal;
+        glm::vec2 texCoord;
+    };
+
+    ClipVertex Lerp(const ClipVertex& a, const ClipVertex& b, float t) {
+        ClipVertex v;
+        v.clip = glm::mix(a.clip, b.clip, t);
+        v.world = glm::mix(a.world, b.world, t);
+        v.normal = glm::mix(a.normal, b.normal, t);
+        v.texCoord = glm::mix(a.texCoord, b.texCoord, t);
+        return v;
+    }
+
+    //edge function of the edge from a to b, positive on the inside once the triangle is oriented
+    struct Edge {
+        float a, b, c;
+        bool includesZero; //top-left rule, pixels exactly on the edge belong to one of the two triangles
+
+        void setup(const glm::vec2& from, const glm::vec2& to, float sign) {
+            a = (from.y - to.y) * sign;
+            b = (to.x - from.x) * sign;
+            c = (from.x * to.y - to.x * from.y) * sign;
+            includesZero = (a > 0.0f) || (a == 0.0f && b > 0.0f);
+        }
+
+        float at(float x, float y) const {
+            return a * x + b * y + c;
+        }
+
+        bool inside(float value) const {
+            return includesZero ? value >= 0.0f : value > 0.0f;
+        }
+    };
+}
+
+Rasterizer::Rasterizer(int width, int height, ThreadPool& threadPool) :
+    _width(width),
+    _height(height),
+    _tilesX((width + TILE_SIZE - 1) / TILE_SIZE),
+    _tilesY((height + TILE_SIZE - 1) / TILE_SIZE),
+    _threadPool(threadPool),
+    _clearColor(0.0f)
+{
+    if(width <= 0 || height <= 0)
+        throw std::runtime_error("Rasterizer size must be positive");
+
+    _tileTriangles.resize((size_t)_tilesX * _tilesY);
+    _color.resize((size_t)width * height, 0);
+    _depth.resize((size_t)width * height, 1.0f);
+    _visible.resize((size_t)width * height, NO_TRIANGLE);
+}
+
+int Rasterizer::width() const
+{
+    return _width;
+}
+
+int Rasterizer::height() const
+{
+    return _height;
+}
+
+void Rasterizer::setTextures(const std::vector<Bitmap>& layers)
+{
+    _shading.setTextures(layers);
+}
+
+void Rasterizer::beginFrame(const glm::mat4& camera, const glm::vec3& cameraPosition,
+                            const std::vector<Light>& lights, const glm::vec3& clearColor)
+{
+    _shading.setLights(lights, cameraPosition);
+    _camera = camera;
+    _clearColor = clearColor;
+    _materials.clear();
+    _triangles.clear();
+    for(size_t i = 0; i < _tileTriangles.size(); ++i)
+        _tileTriangles[i].clear();
+}
+
+void Rasterizer::draw(const Vertex* vertices, size_t vertexCount, const glm::mat4& model, const Material& material)
+{
+    if(material.textureLayer < 0 || (size_t)material.textureLayer >= _shading.layerCount())
+        throw std::runtime_error("Rasterizer material uses a texture layer that does not exist");
+
+    unsigned materialIndex = (unsigned)_materials.size();
+    _materials.push_back(material);
+    const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+
+    for(size_t t = 0; t + 2 < vertexCount; t += 3) {
+        ClipVertex corners[3];
+        for(int i = 0; i < 3; ++i) {
+            const Vertex& v = vertices[t + i];
+            glm::vec4 world = model * glm::vec4(v.position, 1.0f);
+            corners[i].world = glm::vec3(world);
+            corners[i].normal = normalMatrix * v.normal;
+            corners[i].texCoord = v.texCoord;
+            corners[i].clip = _camera * world;
+        }
+
+        //all corners outside of the same plane, except near and far which are handled below
+        bool outside = false;
+        for(int axis = 0; axis < 2 && !outside; ++axis) {
+            outside = (corners[0].clip[axis] < -corners[0].clip.w && corners[1].clip[axis] < -corners[1].clip.w && corners[2].clip[axis] < -corners[2].clip.w) ||
+                      (corners[0].clip[axis] >  corners[0].clip.w && corners[1].clip[axis] >  corners[1].clip.w && corners[2].clip[axis] >  corners[2].clip.w);
+        }
+        if(outside || (corners[0].clip.z > corners[0].clip.w && corners[1].clip.z > corners[1].clip.w && corners[2].clip.z > corners[2].clip.w))
+            continue;
+
+        //clip against the near plane z = -w, which leaves up to four corners
+        ClipVertex polygon[4];
+        int count = 0;
+        for(int i = 0; i < 3; ++i) {
+            const ClipVertex& a = corners[i];
+            const ClipVertex& b = corners[(i + 1) % 3];
+            float da = a.clip.z + a.clip.w;
+            float db = b.clip.z + b.clip.w;
+            if(da >= 0.0f)
+                polygon[count++] = a;
+            if((da >= 0.0f) != (db >= 0.0f))
+                polygon[count++] = Lerp(a, b, da / (da - db));
+        }
+
+        for(int i = 1; i + 1 < count; ++i) {
+            glm::vec4 clip[3] = { polygon[0].clip, polygon[i].clip, polygon[i + 1].clip };
+            glm::vec3 world[3] = { polygon[0].world, polygon[i].world, polygon[i + 1].world };
+            glm::vec3 normal[3] = { polygon[0].normal, polygon[i].normal, polygon[i + 1].normal };
+            glm::vec2 texCoord[3] = { polygon[0].texCoord, polygon[i].texCoord, polygon[i + 1].texCoord };
+            _setupTriangle(clip, world, normal, texCoord, materialIndex);
+        }
+    }
+}
+
+void Rasterizer::_setupTriangle(const glm::vec4 clip[3], const glm::vec3 world[3], const glm::vec3 normal[3],
+                                const glm::vec2 texCoord[3], unsigned material)
+{
+    SetupTriangle triangle;
+    glm::vec2 boundsMin(FLT_MAX);
+    glm::vec2 boundsMax(-FLT_MAX);
+    for(int i = 0; i < 3; ++i) {
+        float invW = 1.0f / clip[i].w;
+        glm::vec3 ndc = glm::vec3(clip[i]) * invW;
+        //snapped to 1/256 of a pixel like GL does, so vertices on the edge of a neighbouring quad leave no cracks
+        glm::vec2 screen((ndc.x * 0.5f + 0.5f) * (float)_width, (0.5f - ndc.y * 0.5f) * (float)_height);
+        triangle.screen[i] = glm::floor(screen * 256.0f + 0.5f) / 256.0f;
+        triangle.depth[i] = ndc.z * 0.5f + 0.5f;
+        triangle.invW[i] = invW;
+        triangle.texCoordOverW[i] = texCoord[i] * invW;
+        triangle.worldPosOverW[i] = world[i] * invW;
+        triangle.normalOverW[i] = normal[i] * invW;
+        boundsMin = glm::min(boundsMin, triangle.screen[i]);
+        boundsMax = glm::max(boundsMax, triangle.screen[i]);
+    }
+
+    glm::vec2 e1 = triangle.screen[1] - triangle.screen[0];
+    glm::vec2 e2 = triangle.screen[2] - triangle.screen[0];
+    if(e1.x * e2.y - e1.y * e2.x == 0.0f)
+        return;
+
+    //pixel centers are at +0.5
+    triangle.minX = std::max(0, (int)std::floor(boundsMin.x - 0.5f));
+    triangle.minY = std::max(0, (int)std::floor(boundsMin.y - 0.5f));
+    triangle.maxX = std::min(_width - 1, (int)std::ceil(boundsMax.x - 0.5f));
+    triangle.maxY = std::min(_height - 1, (int)std::ceil(boundsMax.y - 0.5f));
+    if(triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    triangle.material = material;
+    uint32_t index = (uint32_t)_triangles.size();
+    _triangles.push_back(triangle);
+    _binTriangle(triangle, index);
+}
+
+void Rasterizer::_binTriangle(const SetupTriangle& triangle, uint32_t index)
+{
+    int tileX0 = triangle.minX / TILE_SIZE;
+    int tileY0 = triangle.minY / TILE_SIZE;
+    int tileX1 = triangle.maxX / TILE_SIZE;
+    int tileY1 = triangle.maxY / TILE_SIZE;
+    for(int ty = tileY0; ty <= tileY1; ++ty) {
+        for(int tx = tileX0; tx <= tileX1; ++tx)
+            _tileTriangles[(size_t)ty * _tilesX + tx].push_back(index);
+    }
+}
+
+void Rasterizer::endFrame()
+{
+    _threadPool.parallelFor(_tileTriangles.size(), [this](size_t tile) {
+        _rasterizeTile((int)(tile % _tilesX), (int)(tile / _tilesX));
+    });
+}
+
+size_t Rasterizer::triangleCount() const
+{
+    return _triangles.size();
+}
+
+Bitmap Rasterizer::readPixels() const
+{
+    Bitmap bitmap((unsigned)_width, (unsigned)_height, Bitmap::Format_RGB);
+    unsigned char* out = bitmap.pixelBuffer();
+    for(size_t p = 0; p < _color.size(); ++p) {
+        out[p * 3 + 0] = (unsigned char)(_color[p] & 0xff);
+        out[p * 3 + 1] = (unsigned char)((_color[p] >> 8) & 0xff);
+        out[p * 3 + 2] = (unsigned char)((_color[p] >> 16) & 0xff);
+    }
+    return bitmap;
+}
+
+void Rasterizer::_rasterizeTile(int tileX, int tileY)
+{
+    int x0 = tileX * TILE_SIZE;
+    int y0 = tileY * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, _width) - 1;
+    int y1 = std::min(y0 + TILE_SIZE, _height) - 1;
+
+    uint32_t clear = PackColor(_clearColor, 1.0f);
+    for(int y = y0; y <= y1; ++y) {
+        std::fill(_color.begin() + (size_t)y * _width + x0, _color.begin() + (size_t)y * _width + x1 + 1, clear);
+        std::fill(_depth.begin() + (size_t)y * _width + x0, _depth.begin() + (size_t)y * _width + x1 + 1, 1.0f);
+        std::fill(_visible.begin() + (size_t)y * _width + x0, _visible.begin() + (size_t)y * _width + x1 + 1, NO_TRIANGLE);
+    }
+
+    const std::vector<uint32_t>& indices = _tileTriangles[(size_t)tileY * _tilesX + tileX];
+
+    //opaque depth first, then shade only the visible opaque surface, then blend the transparent triangles in order
+    for(size_t i = 0; i < indices.size(); ++i) {
+        const SetupTriangle& triangle = _triangles[indices[i]];
+        if(!_materials[triangle.material].transparent)
+            _rasterizeTriangle(triangle, indices[i], x0, y0, x1, y1, Pass_Depth);
+    }
+    for(size_t i = 0; i < indices.size(); ++i) {
+        const SetupTriangle& triangle = _triangles[indices[i]];
+        if(!_materials[triangle.material].transparent)
+            _rasterizeTriangle(triangle, indices[i], x0, y0, x1, y1, Pass_Shade);
+    }
+    for(size_t i = 0; i < indices.size(); ++i) {
+        const SetupTriangle& triangle = _triangles[indices[i]];
+        if(_materials[triangle.material].transparent)
+            _rasterizeTriangle(triangle, indices[i], x0, y0, x1, y1, Pass_Blend);
+    }
+}
+
+void Rasterizer::_rasterizeTriangle(const SetupTriangle& triangle, uint32_t index, int x0, int y0, int x1, int y1, Pass pass)
+{
+    x0 = std::max(x0, triangle.minX);
+    y0 = std::max(y0, triangle.minY);
+    x1 = std::min(x1, triangle.maxX);
+    y1 = std::min(y1, triangle.maxY);
+    if(x0 > x1 || y0 > y1)
+        return;
+
+    const glm::vec2* s = triangle.screen;
+    float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[1].y - s[0].y) * (s[2].x - s[0].x);
+    float sign = (area < 0.0f) ? -1.0f : 1.0f;
+    float invArea = 1.0f / (area * sign);
+
+    //edge i is opposite of corner i, so its value is the barycentric weight of corner i times the area
+    Edge edges[3];
+    edges[0].setup(s[1], s[2], sign);
+    edges[1].setup(s[2], s[0], sign);
+    edges[2].setup(s[0], s[1], sign);
+
+    //screen space gradients of 1/w and texCoord/w, for the texture LOD of every pixel
+    const Material& material = _materials[triangle.material];
+    glm::vec3 gradX(0.0f), gradY(0.0f); //x: 1/w, y: u/w, z: v/w
+    for(int i = 0; i < 3; ++i) {
+        glm::vec3 value(triangle.invW[i], triangle.texCoordOverW[i]);
+        gradX += edges[i].a * invArea * value;
+        gradY += edges[i].b * invArea * value;
+    }
+    const glm::vec2 textureSize = _shading.textureSize(material.textureLayer);
+
+    for(int y = y0; y <= y1; ++y) {
+        float py = (float)y + 0.5f;
+        float rowBase[3] = { edges[0].b * py + edges[0].c, edges[1].b * py + edges[1].c, edges[2].b * py + edges[2].c };
+
+        for(int x = x0; x <= x1; x += 4) {
+            //which of the (up to) four pixels x .. x + 3 are inside
+            int coverage;
+#ifdef RASTERIZER_SSE2
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for(int e = 0; e < 3; ++e) {
+                __m128 value = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edges[e].a), px), _mm_set1_ps(rowBase[e]));
+                __m128 test = edges[e].includesZero ? _mm_cmpge_ps(value, _mm_setzero_ps()) : _mm_cmpgt_ps(value, _mm_setzero_ps());
+                inside = _mm_and_ps(inside, test);
+            }
+            coverage = _mm_movemask_ps(inside);
+#else
+            coverage = 0;
+            for(int lane = 0; lane < 4; ++lane) {
+                float px = (float)(x + lane) + 0.5f;
+                bool inside = true;
+                for(int e = 0; e < 3 && inside; ++e)
+                    inside = edges[e].inside(edges[e].a * px + rowBase[e]);
+                if(inside)
+                    coverage |= 1 << lane;
+            }
+#endif
+            if(x + 3 > x1)
+                coverage &= (1 << (x1 - x + 1)) - 1;
+
+            for(int lane = 0; coverage != 0; ++lane, coverage >>= 1) {
+                if(!(coverage & 1))
+                    continue;
+
+                float px = (float)(x + lane) + 0.5f;
+                float b0 = (edges[0].a * px + rowBase[0]) * invArea;
+                float b1 = (edges[1].a * px + rowBase[1]) * invArea;
+                float b2 = (edges[2].a * px + rowBase[2]) * invArea;
+                float depth = b0 * triangle.depth[0] + b1 * triangle.depth[1] + b2 * triangle.depth[2];
+
+                //the shade pass only keeps the triangle that won the depth test, like GL_LESS does for equal depths
+                size_t pixel = (size_t)y * _width + x + lane;
+                if(pass == Pass_Shade ? (_visible[pixel] != index) : !(depth < _depth[pixel]))
+                    continue;
+                if(pass == Pass_Depth) {
+                    _depth[pixel] = depth;
+                    _visible[pixel] = index;
+                    continue;
+                }
+
+                //derivatives of the texture coordinates, texCoord = (texCoord/w) / (1/w)
+                float invW = b0 * triangle.invW[0] + b1 * triangle.invW[1] + b2 * triangle.invW[2];
+                glm::vec2 texCoord = (b0 * triangle.texCoordOverW[0] + b1 * triangle.texCoordOverW[1] + b2 * triangle.texCoordOverW[2]) / invW;
+                glm::vec2 dx = (glm::vec2(gradX.y, gradX.z) - texCoord * gradX.x) / invW * textureSize;
+                glm::vec2 dy = (glm::vec2(gradY.y, gradY.z) - texCoord * gradY.x) / invW * textureSize;
+                float rho = std::max(glm::dot(dx, dx), glm::dot(dy, dy));
+                float lod = (rho > 0.0f) ? 0.5f * std::log2(rho) : 0.0f;
+
+                float w = 1.0f / invW;
+                glm::vec3 surfacePos = (b0 * triangle.worldPosOverW[0] + b1 * triangle.worldPosOverW[1] + b2 * triangle.worldPosOverW[2]) * w;
+                glm::vec3 normal = glm::normalize((b0 * triangle.normalOverW[0] + b1 * triangle.normalOverW[1] + b2 * triangle.normalOverW[2]) * w);
+                glm::vec4 color = _shading.shade(material, surfacePos, normal, texCoord, lod);
+                if(material.transparent) {
+                    glm::vec3 blended = glm::mix(UnpackColor(_color[pixel]), glm::vec3(color), color.a);
+                    _color[pixel] = PackColor(blended, 1.0f);
+                } else {
+                    _color[pixel] = PackColor(glm::vec3(color), 1.0f);
+                }
+                _depth[pixel] = depth;
+            }
+        }
+    }
+}
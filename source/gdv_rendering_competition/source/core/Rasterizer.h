@@ -0,0 +1,128 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "Bitmap.h"
+#include "Shading.h"
+#include "ThreadPool.h"
+
+namespace core {
+
+    /**
+     Renders textured, lit triangles on the CPU, without any OpenGL. It follows
+     vertex-shader.txt and fragment-shader.txt, so its images can be compared
+     with the OpenGL ones: the pixels are shaded by Shading, with perspective
+     correct interpolation, a depth test with GL_LESS and alpha blending.
+
+     Triangles are clipped and binned into tiles of TILE_SIZE x TILE_SIZE pixels
+     while they are drawn. endFrame() then rasterizes all tiles in parallel,
+     every tile in draw order, so the result does not depend on the thread count.
+     Inside a tile the edge functions are evaluated for four pixels at once with
+     SSE2 where it is available.
+
+     Opaque triangles are rasterized depth-only first, so every pixel is shaded
+     once. Blending is only done for the triangles of transparent materials, which
+     have to be drawn after all opaque ones, like in Render().
+     */
+    class Rasterizer {
+    public:
+        static const int TILE_SIZE = 64;
+
+        struct Vertex {
+            glm::vec3 position;
+            glm::vec2 texCoord;
+            glm::vec3 normal;
+        };
+
+        typedef Shading::Material Material;
+        typedef Shading::Light Light;
+
+        Rasterizer(int width, int height, ThreadPool& threadPool);
+
+        int width() const;
+
+        int height() const;
+
+        /**
+         Sets the texture layers the materials refer to, like a texture array.
+         The bitmaps are sRGB colors, RGB or RGBA, and all have the same size.
+         Their mipmaps are built here.
+         */
+        void setTextures(const std::vector<Bitmap>& layers);
+
+        /**
+         Starts a new frame, the draw calls until endFrame() use these settings.
+         */
+        void beginFrame(const glm::mat4& camera, const glm::vec3& cameraPosition,
+                        const std::vector<Light>& lights, const glm::vec3& clearColor);
+
+        /**
+         Draws a triangle list, `model` transforms the vertices into world space.
+         */
+        void draw(const Vertex* vertices, size_t vertexCount, const glm::mat4& model, const Material& material);
+
+        /**
+         Rasterizes everything drawn since beginFrame().
+         */
+        void endFrame();
+
+        /**
+         @return the number of triangles that were binned into tiles during the last frame
+         */
+        size_t triangleCount() const;
+
+        /**
+         The image of the last frame, RGB with the top row first like Framebuffer::readPixels().
+         */
+        Bitmap readPixels() const;
+
+    private:
+        enum Pass {
+            Pass_Depth, //opaque triangles, depth and `_visible` only
+            Pass_Shade, //opaque triangles, shades the pixels they are visible in
+            Pass_Blend  //transparent triangles with depth test and blending
+        };
+
+        //a triangle in screen space, ready for the edge functions
+        struct SetupTriangle {
+            glm::vec2 screen[3];     //pixels, y down
+            float depth[3];          //window depth from 0 to 1
+            float invW[3];
+            glm::vec2 texCoordOverW[3];
+            glm::vec3 worldPosOverW[3];
+            glm::vec3 normalOverW[3];
+            int minX, minY, maxX, maxY; //pixel bounds, inclusive
+            unsigned material;
+        };
+
+        int _width;
+        int _height;
+        int _tilesX;
+        int _tilesY;
+        ThreadPool& _threadPool;
+
+        Shading _shading;
+
+        glm::mat4 _camera;
+        glm::vec3 _clearColor;
+
+        std::vector<Material> _materials;
+        std::vector<SetupTriangle> _triangles;
+        std::vector<std::vector<uint32_t> > _tileTriangles; //indices into `_triangles` per tile, in draw order
+
+        std::vector<uint32_t> _color; //RGBA8, top row first
+        std::vector<float> _depth;
+        std::vector<uint32_t> _visible; //the opaque triangle in front, written by the depth pass
+
+        void _setupTriangle(const glm::vec4 clip[3], const glm::vec3 world[3], const glm::vec3 normal[3],
+                            const glm::vec2 texCoord[3], unsigned material);
+        void _binTriangle(const SetupTriangle& triangle, uint32_t index);
+        void _rasterizeTile(int tileX, int tileY);
+        void _rasterizeTriangle(const SetupTriangle& triangle, uint32_t index, int x0, int y0, int x1, int y1, Pass pass);
+
+        //copying disabled
+        Rasterizer(const Rasterizer&);
+        const Rasterizer& operator=(const Rasterizer&);
+    };
+}
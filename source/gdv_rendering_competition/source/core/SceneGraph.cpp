@@ -0,0 +1,184 @@
+#include "SceneGraph.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCENEGRAPH_SSE2
+#endif
+
+using namespace core;
+
+namespace {
+    //nodes per job of update(JobSystem&), a node only takes tens of nanoseconds
+    const size_t NODES_PER_JOB = 2048;
+
+    //the rotation and translation as one matrix, like translate(position) * mat4_cast(rotation)
+    void LocalTransform(const glm::vec3& position, const glm::quat& rotation, glm::mat4& result) {
+        result = glm::mat4_cast(rotation);
+        result[3] = glm::vec4(position, 1.0f);
+    }
+
+    //result = a * b, column major like glm, `result` must not be `a`
+    void Multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& result) {
+#ifdef SCENEGRAPH_SSE2
+        const float* pa = &a[0][0];
+        const float* pb = &b[0][0];
+        float* pr = &result[0][0];
+        const __m128 a0 = _mm_loadu_ps(pa);
+        const __m128 a1 = _mm_loadu_ps(pa + 4);
+        const __m128 a2 = _mm_loadu_ps(pa + 8);
+        const __m128 a3 = _mm_loadu_ps(pa + 12);
+
+        //every column of the result is the columns of `a` weighted by a column of `b`
+        for(int column = 0; column < 4; ++column) {
+            const float* weights = pb + column * 4;
+            __m128 c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(weights[0])), _mm_mul_ps(a1, _mm_set1_ps(weights[1]))),
+                                  _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(weights[2])), _mm_mul_ps(a3, _mm_set1_ps(weights[3]))));
+            _mm_storeu_ps(pr + column * 4, c);
+        }
+#else
+        result = a * b;
+#endif
+    }
+}
+
+SceneGraph::SceneGraph() :
+    _firstDirty(0)
+{
+}
+
+SceneGraph::Node SceneGraph::addNode(Node parent, const glm::vec3& position, const glm::quat& rotation)
+{
+    if(parent != NO_PARENT && parent >= _parents.size())
+        throw std::runtime_error("SceneGraph parent node does not exist");
+
+    _parents.push_back(parent);
+    _positions.push_back(position);
+    _rotations.push_back(rotation);
+    _worldTransforms.push_back(glm::mat4());
+    _dirty.push_back(1);
+
+    Node node = _parents.size() - 1;
+    size_t depth = (parent == NO_PARENT) ? 0 : _depths[parent] + 1;
+    _depths.push_back(depth);
+    if(depth == _levels.size())
+        _levels.push_back(std::vector<Node>());
+    _levels[depth].push_back(node);
+    _firstDirty = std::min(_firstDirty, node);
+    return node;
+}
+
+void SceneGraph::setLocalTransform(Node node, const glm::vec3& position, const glm::quat& rotation)
+{
+    _positions[node] = position;
+    _rotations[node] = rotation;
+    _dirty[node] = 1;
+    _firstDirty = std::min(_firstDirty, node);
+}
+
+const glm::vec3& SceneGraph::position(Node node) const
+{
+    return _positions[node];
+}
+
+const glm::quat& SceneGraph::rotation(Node node) const
+{
+    return _rotations[node];
+}
+
+const glm::mat4& SceneGraph::worldTransform(Node node) const
+{
+    return _worldTransforms[node];
+}
+
+const glm::mat4* SceneGraph::worldTransforms() const
+{
+    return _worldTransforms.empty() ? NULL : &_worldTransforms[0];
+}
+
+SceneGraph::Node SceneGraph::parent(Node node) const
+{
+    return _parents[node];
+}
+
+size_t SceneGraph::nodeCount() const
+{
+    return _parents.size();
+}
+
+void SceneGraph::clear()
+{
+    _parents.clear();
+    _positions.clear();
+    _rotations.clear();
+    _worldTransforms.clear();
+    _dirty.clear();
+    _depths.clear();
+    _levels.clear();
+    _firstDirty = 0;
+}
+
+size_t SceneGraph::update()
+{
+    //the parents come first, so their world transforms are already up to date when the children need them.
+    //a recomputed node stays dirty until the end of the pass, which makes its children dirty too
+    const size_t count = _parents.size();
+    size_t updated = 0;
+    glm::mat4 local;
+    for(size_t i = _firstDirty; i < count; ++i) {
+        if(_updateNode(i, local))
+            ++updated;
+    }
+
+    _clearDirty();
+    return updated;
+}
+
+size_t SceneGraph::update(JobSystem& jobs)
+{
+    //every depth is done before the next one starts, so the same as in update() holds for the parents
+    std::atomic<size_t> updated(0);
+    for(size_t depth = 0; depth < _levels.size(); ++depth) {
+        const std::vector<Node>& level = _levels[depth];
+        const size_t first = std::lower_bound(level.begin(), level.end(), _firstDirty) - level.begin();
+        jobs.parallelFor(level.size() - first, NODES_PER_JOB, [&](size_t begin, size_t end) {
+            size_t updatedInRange = 0;
+            glm::mat4 local;
+            for(size_t i = first + begin; i < first + end; ++i) {
+                if(_updateNode(level[i], local))
+                    ++updatedInRange;
+            }
+            updated += updatedInRange;
+        });
+    }
+
+    _clearDirty();
+    return updated.load();
+}
+
+bool SceneGraph::_updateNode(Node node, glm::mat4& local)
+{
+    Node parent = _parents[node];
+    if(parent != NO_PARENT && _dirty[parent])
+        _dirty[node] = 1;
+    if(!_dirty[node])
+        return false;
+
+    if(parent == NO_PARENT) {
+        LocalTransform(_positions[node], _rotations[node], _worldTransforms[node]);
+    } else {
+        LocalTransform(_positions[node], _rotations[node], local);
+        Multiply(_worldTransforms[parent], local, _worldTransforms[node]);
+    }
+    return true;
+}
+
+void SceneGraph::_clearDirty()
+{
+    const size_t count = _parents.size();
+    if(_firstDirty < count)
+        std::fill(_dirty.begin() + _firstDirty, _dirty.end(), (uint8_t)0);
+    _firstDirty = count;
+}
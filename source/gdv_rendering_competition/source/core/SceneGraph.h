@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstdint>
+#include <vector>
+#include "JobSystem.h"
+
+namespace core {
+
+    /**
+     A hierarchy of transforms. Every node has a position and rotation relative
+     to its parent, its world transform is the world transform of the parent
+     times the local one.
+
+     Setting a local transform marks the node dirty. update() then recomputes the
+     world transforms of the dirty nodes and of everything below them, and of
+     nothing else, so nodes that never move cost nothing per frame.
+
+     The nodes are stored as a structure of arrays, with every parent before its
+     children. update() is a single pass from the first dirty node to the end,
+     which only touches the arrays it needs and multiplies the matrices with
+     SSE2 where it is available. The world transforms are contiguous, so they
+     can be copied into instance buffers as they are.
+
+     update(JobSystem&) spreads the work over threads one depth of the hierarchy
+     at a time, because a node only needs its parent, which is one level up.
+     */
+    class SceneGraph {
+    public:
+        typedef size_t Node;
+
+        //the parent of the nodes at the top of the hierarchy
+        static const Node NO_PARENT = (size_t)-1;
+
+        SceneGraph();
+
+        /**
+         Adds a node below `parent`, which has to exist already, or at the top with NO_PARENT.
+         The world transform of the new node is computed by the next update().
+         */
+        Node addNode(Node parent, const glm::vec3& position, const glm::quat& rotation);
+
+        void setLocalTransform(Node node, const glm::vec3& position, const glm::quat& rotation);
+
+        const glm::vec3& position(Node node) const;
+
+        const glm::quat& rotation(Node node) const;
+
+        /**
+         The local transforms of the node and all its parents multiplied together,
+         as they were at the last update().
+         */
+        const glm::mat4& worldTransform(Node node) const;
+
+        /**
+         The world transforms of all nodes, indexed by node.
+         */
+        const glm::mat4* worldTransforms() const;
+
+        Node parent(Node node) const;
+
+        size_t nodeCount() const;
+
+        void clear();
+
+        /**
+         Brings the world transforms of the dirty nodes and their children up to date.
+
+         @return the number of world transforms that were recomputed
+         */
+        size_t update();
+
+        /**
+         The same as update(), with the nodes of every depth spread over the threads of
+         `jobs`. Only worth it for big hierarchies, small depths run on the caller.
+         */
+        size_t update(JobSystem& jobs);
+
+    private:
+        std::vector<Node> _parents;
+        std::vector<glm::vec3> _positions;
+        std::vector<glm::quat> _rotations;
+        std::vector<glm::mat4> _worldTransforms;
+        std::vector<uint8_t> _dirty;
+        Node _firstDirty; //no node before it is dirty, nodeCount() if none is
+        std::vector<size_t> _depths; //0 for the nodes at the top
+        std::vector<std::vector<Node> > _levels; //the nodes of every depth, in ascending order
+
+        bool _updateNode(Node node, glm::mat4& local); //`local` is scratch space
+        void _clearDirty();
+    };
+}
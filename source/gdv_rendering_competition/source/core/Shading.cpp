@@ -0,0 +1,168 @@
+#include "Shading.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace core;
+
+namespace {
+    //sRGB texel to linear color, what GL does when it samples a GL_SRGB8_ALPHA8 texture
+    struct SRGBToLinearTable {
+        float values[256];
+
+        SRGBToLinearTable() {
+            for(int i = 0; i < 256; ++i) {
+                float c = (float)i / 255.0f;
+                values[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+        }
+    };
+
+    const float* SRGBToLinear() {
+        static SRGBToLinearTable table;
+        return table.values;
+    }
+
+    int Wrap(int i, int size) {
+        i %= size;
+        return (i < 0) ? i + size : i;
+    }
+}
+
+Shading::Shading() :
+    _cameraPosition(0.0f)
+{
+}
+
+void Shading::setTextures(const std::vector<Bitmap>& layers)
+{
+    _layers.clear();
+    for(size_t i = 0; i < layers.size(); ++i) {
+        if(layers[i].format() != Bitmap::Format_RGB && layers[i].format() != Bitmap::Format_RGBA)
+            throw std::runtime_error("Software textures must be RGB or RGBA");
+
+        //the same mip chain as TextureArray builds, stored as RGBA
+        std::vector<MipLevel> levels;
+        Bitmap mip(layers[i]);
+        for(;;) {
+            MipLevel level;
+            level.width = (int)mip.width();
+            level.height = (int)mip.height();
+            level.texels.resize((size_t)level.width * level.height * 4);
+            unsigned channels = (unsigned)mip.format();
+            const unsigned char* pixels = mip.pixelBuffer();
+            for(size_t p = 0; p < (size_t)level.width * level.height; ++p) {
+                for(unsigned c = 0; c < 3; ++c)
+                    level.texels[p * 4 + c] = pixels[p * channels + c];
+                level.texels[p * 4 + 3] = (channels == 4) ? pixels[p * channels + 3] : 255;
+            }
+            levels.push_back(level);
+
+            if(mip.width() == 1 && mip.height() == 1)
+                break;
+            mip.downsample(true);
+        }
+        _layers.push_back(levels);
+    }
+}
+
+size_t Shading::layerCount() const
+{
+    return _layers.size();
+}
+
+glm::vec2 Shading::textureSize(int layer) const
+{
+    const MipLevel& base = _layers[layer][0];
+    return glm::vec2((float)base.width, (float)base.height);
+}
+
+void Shading::setLights(const std::vector<Light>& lights, const glm::vec3& cameraPosition)
+{
+    if(lights.size() > MAX_LIGHTS)
+        throw std::runtime_error("Too many lights for software shading");
+
+    _lights = lights;
+    _cameraPosition = cameraPosition;
+}
+
+glm::vec4 Shading::sample(int layer, glm::vec2 texCoord, float lod) const
+{
+    const std::vector<MipLevel>& levels = _layers[layer];
+    const float* toLinear = SRGBToLinear();
+
+    //trilinear: bilinear in the two closest mip levels, GL_REPEAT wrapping
+    lod = glm::clamp(lod, 0.0f, (float)(levels.size() - 1));
+    int firstLevel = (int)lod;
+    float levelBlend = lod - (float)firstLevel;
+    glm::vec4 result(0.0f);
+    for(int l = 0; l < 2; ++l) {
+        float weight = (l == 0) ? 1.0f - levelBlend : levelBlend;
+        if(weight == 0.0f)
+            continue;
+
+        const MipLevel& level = levels[std::min(firstLevel + l, (int)levels.size() - 1)];
+        float u = texCoord.x * (float)level.width - 0.5f;
+        float v = texCoord.y * (float)level.height - 0.5f;
+        float fu = std::floor(u);
+        float fv = std::floor(v);
+        float tu = u - fu;
+        float tv = v - fv;
+        int x0 = Wrap((int)fu, level.width);
+        int y0 = Wrap((int)fv, level.height);
+        int x1 = (x0 + 1 == level.width) ? 0 : x0 + 1;
+        int y1 = (y0 + 1 == level.height) ? 0 : y0 + 1;
+
+        const int xs[2] = { x0, x1 };
+        const int ys[2] = { y0, y1 };
+        for(int j = 0; j < 2; ++j) {
+            for(int i = 0; i < 2; ++i) {
+                float texelWeight = weight * (i ? tu : 1.0f - tu) * (j ? tv : 1.0f - tv);
+                const uint8_t* texel = &level.texels[((size_t)ys[j] * level.width + xs[i]) * 4];
+                result += texelWeight * glm::vec4(toLinear[texel[0]], toLinear[texel[1]], toLinear[texel[2]], (float)texel[3] / 255.0f);
+            }
+        }
+    }
+    return result;
+}
+
+glm::vec4 Shading::shade(const Material& material, const glm::vec3& surfacePos, const glm::vec3& normal,
+                         glm::vec2 texCoord, float lod) const
+{
+    glm::vec4 surfaceColor = sample(material.textureLayer, texCoord, lod);
+    glm::vec3 surfaceToCamera = glm::normalize(_cameraPosition - surfacePos);
+
+    //ApplyLight() of fragment-shader.txt for every light
+    glm::vec3 linearColor(0.0f);
+    for(size_t i = 0; i < _lights.size(); ++i) {
+        const Light& light = _lights[i];
+        glm::vec3 surfaceToLight;
+        float attenuation = 1.0f;
+        if(light.position.w == 0.0f) {
+            surfaceToLight = glm::normalize(glm::vec3(light.position));
+        } else {
+            glm::vec3 toLight = glm::vec3(light.position) - surfacePos;
+            float distanceToLight = glm::length(toLight);
+            surfaceToLight = toLight / distanceToLight;
+            attenuation = 1.0f / (1.0f + light.attenuation * distanceToLight * distanceToLight);
+            if(glm::dot(-surfaceToLight, light.coneDirection) < light.coneCosine)
+                attenuation = 0.0f;
+        }
+
+        glm::vec3 ambient = light.ambientCoefficient * glm::vec3(surfaceColor) * light.intensities;
+        float diffuseCoefficient = std::max(0.0f, glm::dot(normal, surfaceToLight));
+        glm::vec3 diffuse = diffuseCoefficient * glm::vec3(surfaceColor) * light.intensities;
+        float specularCoefficient = 0.0f;
+        if(diffuseCoefficient > 0.0f)
+            specularCoefficient = std::pow(std::max(0.0f, glm::dot(surfaceToCamera, glm::reflect(-surfaceToLight, normal))), material.shininess);
+        glm::vec3 specular = specularCoefficient * material.specularColor * light.intensities;
+
+        linearColor += ambient + attenuation * (diffuse + specular);
+    }
+
+    const float gamma = 1.0f / 2.2f;
+    glm::vec3 finalColor(std::pow(std::max(linearColor.r, 0.0f), gamma),
+                         std::pow(std::max(linearColor.g, 0.0f), gamma),
+                         std::pow(std::max(linearColor.b, 0.0f), gamma));
+    return glm::vec4(finalColor, surfaceColor.a);
+}
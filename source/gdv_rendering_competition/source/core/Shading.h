@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "Bitmap.h"
+
+namespace core {
+
+    /**
+     The texturing and lighting of fragment-shader.txt on the CPU, shared by the
+     renderers that do not use OpenGL:
+
+     - sRGB textures that are mipmapped, filtered trilinearly and repeated
+     - Phong lighting with point, spot and directional lights
+     - the output is gamma corrected like `finalColor`
+
+     All methods are const once the textures and lights are set, so many threads
+     can shade at the same time.
+     */
+    class Shading {
+    public:
+        static const size_t MAX_LIGHTS = 32;
+
+        struct Material {
+            int textureLayer;
+            float shininess;
+            glm::vec3 specularColor;
+            bool transparent; //blended with what is behind it
+        };
+
+        //the same fields as the Light struct of fragment-shader.txt
+        struct Light {
+            glm::vec4 position;  //w == 0 for directional lights
+            glm::vec3 intensities;
+            float attenuation;
+            float ambientCoefficient;
+            float coneCosine;
+            glm::vec3 coneDirection;
+        };
+
+        Shading();
+
+        /**
+         Sets the texture layers the materials refer to, like a texture array.
+         The bitmaps are sRGB colors, RGB or RGBA. Their mipmaps are built here.
+         */
+        void setTextures(const std::vector<Bitmap>& layers);
+
+        size_t layerCount() const;
+
+        /**
+         @return the size of mip level 0 of `layer` in texels
+         */
+        glm::vec2 textureSize(int layer) const;
+
+        void setLights(const std::vector<Light>& lights, const glm::vec3& cameraPosition);
+
+        /**
+         Samples `layer` like `texture()` with GL_LINEAR_MIPMAP_LINEAR and GL_REPEAT.
+
+         @return the linear color and alpha
+         */
+        glm::vec4 sample(int layer, glm::vec2 texCoord, float lod) const;
+
+        /**
+         Lights a surface point with all lights, `normal` has to be normalized.
+
+         @return the gamma corrected color and the alpha of the texture
+         */
+        glm::vec4 shade(const Material& material, const glm::vec3& surfacePos, const glm::vec3& normal,
+                        glm::vec2 texCoord, float lod) const;
+
+    private:
+        struct MipLevel {
+            int width;
+            int height;
+            std::vector<uint8_t> texels; //RGBA, sRGB colors and linear alpha
+        };
+
+        std::vector<std::vector<MipLevel> > _layers;
+        std::vector<Light> _lights;
+        glm::vec3 _cameraPosition;
+    };
+}
@@ -1,5 +1,6 @@
 #include "Texture.h"
 #include <stdexcept>
+#include "TextureUtil.h"
 
 using namespace core;
 
@@ -14,16 +15,19 @@ static GLenum TextureFormatForBitmapFormat(Bitmap::Format format, bool srgb)
     }
 }
 
-Texture::Texture(const Bitmap& bitmap, GLint minMagFiler, GLint wrapMode) :
+Texture::Texture(const Bitmap& bitmap, GLint minMagFiler, GLint wrapMode, GLfloat anisotropy) :
     _originalWidth((GLfloat)bitmap.width()),
     _originalHeight((GLfloat)bitmap.height())
 {
     glGenTextures(1, &_object);
     glBindTexture(GL_TEXTURE_2D, _object);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minMagFiler);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, minMagFiler);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, TextureUtil::MagFilterForMinFilter(minMagFiler));
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+    TextureUtil::SetAnisotropy(GL_TEXTURE_2D, anisotropy);
+
+    TextureUtil::TightUnpacking unpacking;
     glTexImage2D(GL_TEXTURE_2D,
                  0, 
                  TextureFormatForBitmapFormat(bitmap.format(), true),
@@ -33,6 +37,27 @@ Texture::Texture(const Bitmap& bitmap, GLint minMagFiler, GLint wrapMode) :
                  TextureFormatForBitmapFormat(bitmap.format(), false),
                  GL_UNSIGNED_BYTE, 
                  bitmap.pixelBuffer());
+
+    if(TextureUtil::IsMipmapFilter(minMagFiler)) {
+        //only the color formats are stored as sRGB, so only those are filtered in linear space
+        bool srgb = (bitmap.format() == Bitmap::Format_RGB || bitmap.format() == Bitmap::Format_RGBA);
+        Bitmap mip(bitmap);
+        GLint level = 0;
+        while(mip.width() > 1 || mip.height() > 1) {
+            mip.downsample(srgb);
+            ++level;
+            glTexImage2D(GL_TEXTURE_2D,
+                         level,
+                         TextureFormatForBitmapFormat(mip.format(), true),
+                         (GLsizei)mip.width(),
+                         (GLsizei)mip.height(),
+                         0,
+                         TextureFormatForBitmapFormat(mip.format(), false),
+                         GL_UNSIGNED_BYTE,
+                         mip.pixelBuffer());
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+    }
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
@@ -8,9 +8,15 @@ namespace core {
     class Texture {
     public:
 
+        /**
+         If `minMagFiler` is one of the *_MIPMAP_* filters the whole mipmap chain is built on
+         the CPU with Bitmap::downsample(), GL_LINEAR_MIPMAP_LINEAR gives trilinear filtering.
+         An `anisotropy` above 1 enables anisotropic filtering, clamped to what the driver supports.
+         */
         Texture(const Bitmap& bitmap,
                 GLint minMagFiler = GL_LINEAR,
-                GLint wrapMode = GL_CLAMP_TO_EDGE);
+                GLint wrapMode = GL_CLAMP_TO_EDGE,
+                GLfloat anisotropy = 1.0f);
         
         ~Texture();
         
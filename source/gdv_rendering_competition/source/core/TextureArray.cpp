@@ -0,0 +1,147 @@
+#include "TextureArray.h"
+#include <stdexcept>
+#include "TextureUtil.h"
+
+using namespace core;
+
+static GLenum PixelFormatForBitmapFormat(Bitmap::Format format)
+{
+    switch (format) {
+        case Bitmap::Format_RGB: return GL_RGB;
+        case Bitmap::Format_RGBA: return GL_RGBA;
+        default: throw std::runtime_error("TextureArray layers must be RGB or RGBA");
+    }
+}
+
+TextureArray::TextureArray(const std::vector<Bitmap>& layers, GLint minMagFiler, GLint wrapMode, GLfloat anisotropy) :
+    TextureArray((GLsizei)layers.size(), minMagFiler, wrapMode, anisotropy)
+{
+    for(GLsizei layer = 0; layer < _layerCount; ++layer)
+        setLayer(layer, layers[layer]);
+}
+
+TextureArray::TextureArray(GLsizei layerCount, GLint minMagFiler, GLint wrapMode, GLfloat anisotropy) :
+    _layerCount(layerCount),
+    _width(0),
+    _height(0),
+    _levels(0),
+    _mipmapped(TextureUtil::IsMipmapFilter(minMagFiler))
+{
+    if(layerCount <= 0)
+        throw std::runtime_error("TextureArray needs at least one layer");
+
+    GLint maxLayers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    if(_layerCount > maxLayers)
+        throw std::runtime_error("Too many layers for a TextureArray");
+
+    glGenTextures(1, &_object);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, _object);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, minMagFiler);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, TextureUtil::MagFilterForMinFilter(minMagFiler));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrapMode);
+    TextureUtil::SetAnisotropy(GL_TEXTURE_2D_ARRAY, anisotropy);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+TextureArray::~TextureArray()
+{
+    glDeleteTextures(1, &_object);
+}
+
+GLuint TextureArray::object() const
+{
+    return _object;
+}
+
+GLsizei TextureArray::layerCount() const
+{
+    return _layerCount;
+}
+
+GLfloat TextureArray::width() const
+{
+    return _width;
+}
+
+GLfloat TextureArray::height() const
+{
+    return _height;
+}
+
+void TextureArray::setLayer(GLsizei layer, const Bitmap& bitmap)
+{
+    _bindLayer(layer, bitmap.width(), bitmap.height());
+
+    TextureUtil::TightUnpacking unpacking;
+    Bitmap mip(bitmap);
+    for(GLint level = 0; level < _levels; ++level) {
+        if(level > 0)
+            mip.downsample(true);
+
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY,
+                        level,
+                        0, 0, layer,
+                        (GLsizei)mip.width(), (GLsizei)mip.height(), 1,
+                        PixelFormatForBitmapFormat(mip.format()),
+                        GL_UNSIGNED_BYTE,
+                        mip.pixelBuffer());
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void TextureArray::setLayer(GLsizei layer, const TextureFile& file)
+{
+    GLenum pixelFormat = PixelFormatForBitmapFormat(file.format());
+    _bindLayer(layer, file.width(), file.height());
+    if(file.levelCount() < (unsigned)_levels) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        throw std::runtime_error("TextureFile has fewer mipmaps than the TextureArray");
+    }
+
+    TextureUtil::TightUnpacking unpacking;
+    for(GLint level = 0; level < _levels; ++level) {
+        TextureFile::Level mip = file.level((unsigned)level);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY,
+                        level,
+                        0, 0, layer,
+                        (GLsizei)mip.width, (GLsizei)mip.height, 1,
+                        pixelFormat,
+                        GL_UNSIGNED_BYTE,
+                        mip.pixels);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void TextureArray::_bindLayer(GLsizei layer, unsigned width, unsigned height)
+{
+    if(layer < 0 || layer >= _layerCount)
+        throw std::runtime_error("TextureArray layer does not exist");
+    if(_levels > 0 && (width != (unsigned)_width || height != (unsigned)_height))
+        throw std::runtime_error("All layers of a TextureArray must have the same size");
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, _object);
+
+    //the first layer decides the size, allocate all layers of every level, GL converts RGB to RGBA on upload
+    if(_levels == 0) {
+        _width = (GLfloat)width;
+        _height = (GLfloat)height;
+        _levels = _mipmapped ? TextureUtil::MipmapLevelCount(width, height) : 1;
+        for(GLint level = 0; level < _levels; ++level) {
+            GLsizei levelWidth = (GLsizei)(width >> level) > 0 ? (GLsizei)(width >> level) : 1;
+            GLsizei levelHeight = (GLsizei)(height >> level) > 0 ? (GLsizei)(height >> level) : 1;
+            glTexImage3D(GL_TEXTURE_2D_ARRAY,
+                         level,
+                         GL_SRGB8_ALPHA8,
+                         levelWidth,
+                         levelHeight,
+                         _layerCount,
+                         0,
+                         GL_RGBA,
+                         GL_UNSIGNED_BYTE,
+                         NULL);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, _levels - 1);
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+#include "Bitmap.h"
+#include "TextureFile.h"
+
+namespace core {
+
+    /**
+     A GL_TEXTURE_2D_ARRAY with one layer per bitmap. All bitmaps must have the same
+     size and be RGB or RGBA, the layers are stored as sRGB with alpha (RGB gets alpha 1).
+
+     In GLSL sample it with a `sampler2DArray` and texture(sampler, vec3(uv, layer)).
+     Mipmaps and anisotropic filtering work like they do for Texture.
+
+     The layers can also be filled one at a time with setLayer(), e.g. while the
+     bitmaps of the other layers are still being decoded.
+     */
+    class TextureArray {
+    public:
+
+        TextureArray(const std::vector<Bitmap>& layers,
+                     GLint minMagFiler = GL_LINEAR,
+                     GLint wrapMode = GL_CLAMP_TO_EDGE,
+                     GLfloat anisotropy = 1.0f);
+
+        /**
+         An array of `layerCount` layers that are filled with setLayer(). The size of the
+         layers is the size of the first bitmap set.
+         */
+        TextureArray(GLsizei layerCount,
+                     GLint minMagFiler = GL_LINEAR,
+                     GLint wrapMode = GL_CLAMP_TO_EDGE,
+                     GLfloat anisotropy = 1.0f);
+
+        ~TextureArray();
+
+        GLuint object() const;
+
+        GLsizei layerCount() const;
+
+        GLfloat width() const;
+
+        GLfloat height() const;
+
+        /**
+         Uploads `bitmap` and its mipmaps into `layer`. Binds the texture array to
+         GL_TEXTURE_2D_ARRAY and leaves it unbound.
+         */
+        void setLayer(GLsizei layer, const Bitmap& bitmap);
+
+        /**
+         Uploads `file` into `layer` straight from its mapping. If the array is mipmapped,
+         the file needs all of its levels, see TextureFile::write().
+         */
+        void setLayer(GLsizei layer, const TextureFile& file);
+
+    private:
+        GLuint _object;
+        GLsizei _layerCount;
+        GLfloat _width;
+        GLfloat _height;
+        GLint _levels; //0 until the first layer is set
+        bool _mipmapped;
+
+        //checks the size of a new layer, binds the array and allocates it for the first layer
+        void _bindLayer(GLsizei layer, unsigned width, unsigned height);
+
+        TextureArray(const TextureArray&);
+        const TextureArray& operator=(const TextureArray&);
+    };
+}
@@ -0,0 +1,243 @@
+#include "TextureFile.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace core;
+
+namespace {
+    const char MAGIC[4] = { 'G', 'D', 'V', 'T' };
+    const uint32_t VERSION = 2;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t channels; //see Bitmap::Format
+        uint32_t levelCount;
+        uint64_t sourceSize; //of the image the file was baked from
+        uint64_t sourceTime; //its modification time, in the units of the platform
+    };
+
+    struct LevelEntry {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset; //from the start of the file
+        uint64_t size;
+    };
+
+    //the whole file read-only in memory, NULL if it can't be opened
+    const unsigned char* MapFile(const std::string& filePath, size_t& size) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if(file == INVALID_HANDLE_VALUE)
+            return NULL;
+
+        LARGE_INTEGER fileSize;
+        void* data = NULL;
+        if(GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+            //the view stays valid after both handles are closed
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if(mapping) {
+                data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+            size = (size_t)fileSize.QuadPart;
+        }
+        CloseHandle(file);
+        return (const unsigned char*)data;
+#else
+        int file = open(filePath.c_str(), O_RDONLY);
+        if(file < 0)
+            return NULL;
+
+        struct stat status;
+        void* data = MAP_FAILED;
+        if(fstat(file, &status) == 0 && status.st_size > 0) {
+            size = (size_t)status.st_size;
+            data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+        }
+        close(file);
+        return (data == MAP_FAILED) ? NULL : (const unsigned char*)data;
+#endif
+    }
+
+    void UnmapFile(const unsigned char* data, size_t size) {
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap((void*)data, size);
+#endif
+    }
+
+    //false if the file does not exist
+    bool GetFileStamp(const std::string& filePath, uint64_t& size, uint64_t& time) {
+#ifdef _WIN32
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if(!GetFileAttributesExA(filePath.c_str(), GetFileExInfoStandard, &attributes))
+            return false;
+        size = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+        time = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+        struct stat status;
+        if(stat(filePath.c_str(), &status) != 0)
+            return false;
+        size = (uint64_t)status.st_size;
+        time = (uint64_t)status.st_mtime;
+#endif
+        return true;
+    }
+}
+
+void TextureFile::write(const std::string& filePath, const Bitmap& bitmap, bool mipmaps, const std::string& sourcePath)
+{
+    std::vector<Bitmap> levels(1, bitmap);
+    if(mipmaps) {
+        while(levels.back().width() > 1 || levels.back().height() > 1) {
+            levels.push_back(levels.back());
+            levels.back().downsample(true);
+        }
+    }
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.width = bitmap.width();
+    header.height = bitmap.height();
+    header.channels = (uint32_t)bitmap.format();
+    header.levelCount = (uint32_t)levels.size();
+    if(!GetFileStamp(sourcePath, header.sourceSize, header.sourceTime))
+        throw std::runtime_error(std::string("Failed to read the source of texture file: ") + sourcePath);
+
+    std::vector<LevelEntry> entries(levels.size());
+    uint64_t offset = sizeof(Header) + entries.size() * sizeof(LevelEntry);
+    for(size_t i = 0; i < levels.size(); ++i) {
+        entries[i].width = levels[i].width();
+        entries[i].height = levels[i].height();
+        entries[i].offset = offset;
+        entries[i].size = (uint64_t)levels[i].width() * levels[i].height() * levels[i].format();
+        offset += entries[i].size;
+    }
+
+    std::ofstream f(filePath.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if(!f)
+        throw std::runtime_error(std::string("Failed to open texture file for writing: ") + filePath);
+
+    f.write((const char*)&header, sizeof(header));
+    f.write((const char*)&entries[0], entries.size() * sizeof(LevelEntry));
+    for(size_t i = 0; i < levels.size(); ++i)
+        f.write((const char*)levels[i].pixelBuffer(), (std::streamsize)entries[i].size);
+
+    f.close();
+    if(!f)
+        throw std::runtime_error(std::string("Failed to write texture file: ") + filePath);
+}
+
+TextureFile::TextureFile(const std::string& filePath) :
+    _data(NULL),
+    _size(0),
+    _width(0),
+    _height(0),
+    _format(Bitmap::Format_RGBA),
+    _levelCount(0),
+    _sourceSize(0),
+    _sourceTime(0)
+{
+    _data = MapFile(filePath, _size);
+    if(!_data)
+        throw std::runtime_error(std::string("Failed to open texture file: ") + filePath);
+
+    //everything is checked once here, so level() can trust the file. Level i has to be exactly the
+    //size GL expects for mipmap i of the header size and the chain ends at 1 x 1, level 0 is read
+    //as a whole bitmap of the header size
+    Header header;
+    bool valid = (_size >= sizeof(Header));
+    if(valid) {
+        std::memcpy(&header, _data, sizeof(Header));
+        valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION &&
+                header.channels >= 1 && header.channels <= 4 && header.width > 0 && header.height > 0 &&
+                header.levelCount > 0 && header.levelCount <= 32 &&
+                _size >= sizeof(Header) + header.levelCount * sizeof(LevelEntry);
+    }
+    for(uint32_t i = 0; valid && i < header.levelCount; ++i) {
+        LevelEntry entry;
+        std::memcpy(&entry, _data + sizeof(Header) + i * sizeof(LevelEntry), sizeof(LevelEntry));
+        uint32_t levelWidth = std::max(header.width >> i, (uint32_t)1);
+        uint32_t levelHeight = std::max(header.height >> i, (uint32_t)1);
+        bool pastLastLevel = i > 0 && (header.width >> (i - 1)) <= 1 && (header.height >> (i - 1)) <= 1;
+        valid = !pastLastLevel && entry.width == levelWidth && entry.height == levelHeight &&
+                entry.size == (uint64_t)entry.width * entry.height * header.channels &&
+                entry.offset <= _size && entry.size <= _size - entry.offset;
+    }
+    if(!valid) {
+        UnmapFile(_data, _size);
+        throw std::runtime_error(std::string("Not a texture file of this version, bake it again: ") + filePath);
+    }
+
+    _width = header.width;
+    _height = header.height;
+    _format = (Bitmap::Format)header.channels;
+    _levelCount = header.levelCount;
+    _sourceSize = header.sourceSize;
+    _sourceTime = header.sourceTime;
+}
+
+TextureFile::~TextureFile()
+{
+    UnmapFile(_data, _size);
+}
+
+unsigned TextureFile::width() const
+{
+    return _width;
+}
+
+unsigned TextureFile::height() const
+{
+    return _height;
+}
+
+Bitmap::Format TextureFile::format() const
+{
+    return _format;
+}
+
+unsigned TextureFile::levelCount() const
+{
+    return _levelCount;
+}
+
+TextureFile::Level TextureFile::level(unsigned index) const
+{
+    if(index >= _levelCount)
+        throw std::runtime_error("TextureFile level does not exist");
+
+    LevelEntry entry;
+    std::memcpy(&entry, _data + sizeof(Header) + index * sizeof(LevelEntry), sizeof(LevelEntry));
+    Level level;
+    level.width = entry.width;
+    level.height = entry.height;
+    level.pixels = _data + entry.offset;
+    return level;
+}
+
+bool TextureFile::isBakedFrom(const std::string& sourcePath) const
+{
+    uint64_t size, time;
+    return GetFileStamp(sourcePath, size, time) && size == _sourceSize && time == _sourceTime;
+}
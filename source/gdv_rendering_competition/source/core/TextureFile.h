@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "Bitmap.h"
+
+namespace core {
+
+    /**
+     A texture baked into a file that can be uploaded without decoding anything.
+
+     write() stores a bitmap as it is, followed by its mipmaps as Bitmap::downsample()
+     makes them, so a bitmap that is already flipped for GL is stored flipped. Opening
+     the file maps it into memory, level() points straight into the mapping, and
+     TextureArray::setLayer() uploads from there. Pages that were uploaded can be
+     dropped by the OS again, and nothing is copied into a Bitmap.
+
+     The file is a small header, a table with one entry per level and the levels
+     as tightly packed rows, all in the byte order of the machine that baked it.
+     The header keeps the size and modification time of the image it was baked from,
+     so isBakedFrom() can tell when the image was changed afterwards.
+     */
+    class TextureFile {
+    public:
+        struct Level {
+            unsigned width;
+            unsigned height;
+            const unsigned char* pixels; //width * height pixels of format()
+        };
+
+        /**
+         Writes `bitmap` as level 0 and, if `mipmaps` is true, every level down to 1 x 1.
+         `sourcePath` is the image `bitmap` was decoded from. Throws if the file can't be
+         written.
+         */
+        static void write(const std::string& filePath, const Bitmap& bitmap, bool mipmaps, const std::string& sourcePath);
+
+        /**
+         Maps the file into memory. Throws if it can't be opened or is not a texture file
+         of this version.
+         */
+        explicit TextureFile(const std::string& filePath);
+
+        ~TextureFile();
+
+        unsigned width() const;
+
+        unsigned height() const;
+
+        Bitmap::Format format() const;
+
+        unsigned levelCount() const;
+
+        Level level(unsigned index) const;
+
+        /**
+         @return true if `sourcePath` still has the size and modification time it had when
+                 this file was baked from it
+         */
+        bool isBakedFrom(const std::string& sourcePath) const;
+
+    private:
+        const unsigned char* _data;
+        size_t _size;
+        unsigned _width;
+        unsigned _height;
+        Bitmap::Format _format;
+        unsigned _levelCount;
+        unsigned long long _sourceSize;
+        unsigned long long _sourceTime;
+
+        //copying disabled
+        TextureFile(const TextureFile&);
+        const TextureFile& operator=(const TextureFile&);
+    };
+}
@@ -0,0 +1,44 @@
+#include "TextureUtil.h"
+
+using namespace core;
+
+bool TextureUtil::IsMipmapFilter(GLint filter)
+{
+    return filter == GL_NEAREST_MIPMAP_NEAREST || filter == GL_LINEAR_MIPMAP_NEAREST ||
+           filter == GL_NEAREST_MIPMAP_LINEAR || filter == GL_LINEAR_MIPMAP_LINEAR;
+}
+
+GLint TextureUtil::MagFilterForMinFilter(GLint filter)
+{
+    return (filter == GL_NEAREST || filter == GL_NEAREST_MIPMAP_NEAREST || filter == GL_NEAREST_MIPMAP_LINEAR) ? GL_NEAREST : GL_LINEAR;
+}
+
+void TextureUtil::SetAnisotropy(GLenum target, GLfloat anisotropy)
+{
+    if(anisotropy <= 1.0f || !GLEW_EXT_texture_filter_anisotropic)
+        return;
+
+    GLfloat maxAnisotropy = 1.0f;
+    glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+    glTexParameterf(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, (anisotropy < maxAnisotropy) ? anisotropy : maxAnisotropy);
+}
+
+GLint TextureUtil::MipmapLevelCount(unsigned width, unsigned height)
+{
+    GLint levels = 1;
+    for(unsigned size = (width > height) ? width : height; size > 1; size /= 2)
+        ++levels;
+    return levels;
+}
+
+TextureUtil::TightUnpacking::TightUnpacking() :
+    _previousAlignment(4)
+{
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &_previousAlignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+}
+
+TextureUtil::TightUnpacking::~TightUnpacking()
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, _previousAlignment);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <GL/glew.h>
+
+namespace core {
+
+    /**
+     What Texture and TextureArray share when they set up their textures and mipmaps.
+     */
+    namespace TextureUtil {
+
+        bool IsMipmapFilter(GLint filter);
+
+        //magnification never uses mipmaps, so this picks the matching plain filter
+        GLint MagFilterForMinFilter(GLint filter);
+
+        //anisotropy above 1 is clamped to what the driver supports, ignored without the extension
+        void SetAnisotropy(GLenum target, GLfloat anisotropy);
+
+        //the number of levels from `width` x `height` down to 1 x 1, as Bitmap::downsample() makes them
+        GLint MipmapLevelCount(unsigned width, unsigned height);
+
+        /**
+         Sets GL_UNPACK_ALIGNMENT to 1 while it exists and restores the previous value after.
+         The rows of a Bitmap are tightly packed, so uploading an RGB level whose rows are not
+         a multiple of 4 bytes long, like 2 x 2 or 1 x 1, would read the rows shifted and past
+         the end of the pixels with the default alignment of 4.
+         */
+        class TightUnpacking {
+        public:
+            TightUnpacking();
+            ~TightUnpacking();
+
+        private:
+            GLint _previousAlignment;
+
+            //copying disabled
+            TightUnpacking(const TightUnpacking&);
+            const TightUnpacking& operator=(const TightUnpacking&);
+        };
+    }
+}
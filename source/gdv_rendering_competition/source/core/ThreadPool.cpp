@@ -0,0 +1,100 @@
+#include "ThreadPool.h"
+
+using namespace core;
+
+ThreadPool::ThreadPool(size_t threadCount) :
+    _stopping(false),
+    _body(NULL),
+    _count(0),
+    _nextIndex(0),
+    _generation(0),
+    _busyWorkers(0)
+{
+    if(threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if(threadCount == 0)
+        threadCount = 1;
+
+    //the caller is one of the threads
+    for(size_t i = 1; i < threadCount; ++i)
+        _workers.push_back(std::thread(&ThreadPool::_workerMain, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wakeWorkers.notify_all();
+    for(size_t i = 0; i < _workers.size(); ++i)
+        _workers[i].join();
+}
+
+size_t ThreadPool::threadCount() const
+{
+    return _workers.size() + 1;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+    if(count == 0)
+        return;
+
+    if(_workers.empty() || count == 1) {
+        for(size_t i = 0; i < count; ++i)
+            body(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _body = &body;
+        _count = count;
+        _nextIndex = 0;
+        _busyWorkers = _workers.size();
+        ++_generation;
+    }
+    _wakeWorkers.notify_all();
+
+    _runIndices(body, count);
+
+    //`body` must outlive every worker that is still inside it
+    std::unique_lock<std::mutex> lock(_mutex);
+    _loopDone.wait(lock, [this] { return _busyWorkers == 0; });
+    _body = NULL;
+}
+
+void ThreadPool::_workerMain()
+{
+    size_t lastGeneration = 0;
+    for(;;) {
+        const std::function<void(size_t)>* body;
+        size_t count;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeWorkers.wait(lock, [&] { return _stopping || _generation != lastGeneration; });
+            if(_stopping)
+                return;
+            lastGeneration = _generation;
+            body = _body;
+            count = _count;
+        }
+
+        _runIndices(*body, count);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(--_busyWorkers == 0)
+            _loopDone.notify_one();
+    }
+}
+
+void ThreadPool::_runIndices(const std::function<void(size_t)>& body, size_t count)
+{
+    for(;;) {
+        size_t i = _nextIndex.fetch_add(1);
+        if(i >= count)
+            return;
+        body(i);
+    }
+}
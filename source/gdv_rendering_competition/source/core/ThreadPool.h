@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace core {
+
+    /**
+     A fixed set of worker threads for data parallel loops.
+
+     parallelFor() hands out the indices one by one, so uneven amounts of work per
+     index are balanced automatically. The calling thread works on the loop too, and
+     the call returns once every index is done.
+     */
+    class ThreadPool {
+    public:
+        /**
+         @param threadCount  the number of threads working on a loop including the caller,
+                             0 uses one per hardware thread
+         */
+        explicit ThreadPool(size_t threadCount = 0);
+
+        ~ThreadPool();
+
+        /**
+         @return the number of threads working on a loop including the caller
+         */
+        size_t threadCount() const;
+
+        /**
+         Calls `body(i)` for every i from 0 to count - 1, spread over all threads.
+         Must not be called from inside `body`.
+         */
+        void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    private:
+        std::vector<std::thread> _workers;
+        std::mutex _mutex;
+        std::condition_variable _wakeWorkers;
+        std::condition_variable _loopDone;
+        bool _stopping;
+
+        //the current loop, replaced for every parallelFor()
+        const std::function<void(size_t)>* _body;
+        size_t _count;
+        std::atomic<size_t> _nextIndex;
+        size_t _generation;       //counts the loops, so a worker runs every loop once
+        size_t _busyWorkers;
+
+        void _workerMain();
+        void _runIndices(const std::function<void(size_t)>& body, size_t count);
+
+        //copying disabled
+        ThreadPool(const ThreadPool&);
+        const ThreadPool& operator=(const ThreadPool&);
+    };
+}
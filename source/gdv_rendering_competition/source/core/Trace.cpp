@@ -0,0 +1,183 @@
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace core;
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    struct Event {
+        const char* name;
+        const char* detail;
+        Clock::time_point begin;
+        Clock::time_point end;
+    };
+
+    //a ring written only by its own thread, event i is in slot i % size. `count` is the number of
+    //events ever recorded and is published after the event is complete
+    struct ThreadBuffer {
+        unsigned id;
+        std::atomic<const char*> name;
+        std::vector<Event> events;
+        std::atomic<size_t> count;
+    };
+
+    //all buffers ever created, they are never freed so threads may end at any time
+    struct Registry {
+        std::mutex mutex;
+        std::vector<ThreadBuffer*> buffers;
+        std::atomic<bool> enabled;
+        Clock::time_point start;
+
+        Registry() : enabled(false), start(Clock::now()) {}
+    };
+
+    Registry& TheRegistry() {
+        static Registry registry;
+        return registry;
+    }
+
+    //the buffer of a thread is only created by its first record(), so threads that are just
+    //named don't hold a ring of EVENTS_PER_THREAD events while tracing is off
+    thread_local ThreadBuffer* CurrentBuffer = NULL;
+    thread_local const char* CurrentThreadName = NULL;
+
+    ThreadBuffer& CurrentThreadBuffer() {
+        if(!CurrentBuffer) {
+            Registry& registry = TheRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            CurrentBuffer = new ThreadBuffer();
+            CurrentBuffer->id = (unsigned)registry.buffers.size() + 1;
+            CurrentBuffer->name = CurrentThreadName;
+            CurrentBuffer->events.resize(Trace::EVENTS_PER_THREAD);
+            CurrentBuffer->count = 0;
+            registry.buffers.push_back(CurrentBuffer);
+        }
+        return *CurrentBuffer;
+    }
+
+    double Microseconds(Clock::time_point time, Clock::time_point start) {
+        return std::chrono::duration<double, std::micro>(time - start).count();
+    }
+
+    //the names come from the code, but file names may contain backslashes
+    void WriteJSONString(std::ostream& out, const char* text) {
+        out << '"';
+        for(const char* c = text; *c; ++c) {
+            if(*c == '"' || *c == '\\')
+                out << '\\' << *c;
+            else if((unsigned char)*c < 0x20)
+                out << ' ';
+            else
+                out << *c;
+        }
+        out << '"';
+    }
+}
+
+void Trace::setEnabled(bool enabled) {
+    TheRegistry().enabled = enabled;
+}
+
+bool Trace::enabled() {
+    return TheRegistry().enabled;
+}
+
+void Trace::setThreadName(const char* name) {
+    CurrentThreadName = name;
+    if(CurrentBuffer)
+        CurrentBuffer->name = name;
+}
+
+void Trace::record(const char* name, Clock::time_point begin, Clock::time_point end, const char* detail) {
+    if(!enabled())
+        return;
+
+    ThreadBuffer& buffer = CurrentThreadBuffer();
+    size_t index = buffer.count.load(std::memory_order_relaxed);
+    Event& event = buffer.events[index % buffer.events.size()];
+    event.name = name;
+    event.detail = detail;
+    event.begin = begin;
+    event.end = end;
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+size_t Trace::write(const std::string& filePath) {
+    std::ofstream out(filePath.c_str(), std::ios::out | std::ios::trunc);
+    if(!out)
+        throw std::runtime_error(std::string("Could not open trace file: ") + filePath);
+
+    Registry& registry = TheRegistry();
+    std::vector<ThreadBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        buffers = registry.buffers;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    size_t written = 0;
+    bool first = true;
+    char number[64];
+    for(size_t b = 0; b < buffers.size(); ++b) {
+        const ThreadBuffer& buffer = *buffers[b];
+        const char* threadName = buffer.name.load();
+        if(threadName) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.id << ",\"args\":{\"name\":";
+            WriteJSONString(out, threadName);
+            out << "}}";
+            first = false;
+        }
+
+        //copy the ring first, the thread may go on recording and overwrite the oldest events meanwhile.
+        //whatever was recorded more than a ring ago by the time the copy is done may be torn and is left out,
+        //and so is the oldest event left, the thread may be overwriting its slot with event `countAfterCopy`
+        const size_t size = buffer.events.size();
+        size_t count = buffer.count.load(std::memory_order_acquire);
+        size_t oldest = (count > size) ? count - size : 0;
+        std::vector<Event> events(count - oldest);
+        for(size_t i = oldest; i < count; ++i)
+            events[i - oldest] = buffer.events[i % size];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        size_t countAfterCopy = buffer.count.load(std::memory_order_relaxed);
+        size_t firstValid = (countAfterCopy >= size) ? countAfterCopy - size + 1 : 0;
+        size_t skip = (firstValid > oldest) ? std::min(firstValid - oldest, events.size()) : 0;
+
+        //complete events ("X") carry begin and duration in one entry
+        for(size_t i = skip; i < events.size(); ++i) {
+            const Event& event = events[i];
+            out << (first ? "" : ",\n") << "{\"name\":";
+            WriteJSONString(out, event.name);
+            snprintf(number, sizeof(number), ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                     buffer.id, Microseconds(event.begin, registry.start), Microseconds(event.end, event.begin));
+            out << number;
+            if(event.detail) {
+                out << ",\"args\":{\"detail\":";
+                WriteJSONString(out, event.detail);
+                out << "}";
+            }
+            out << "}";
+            first = false;
+            ++written;
+        }
+
+        size_t overwritten = oldest + skip;
+        if(overwritten > 0) {
+            snprintf(number, sizeof(number), "%u older events overwritten", (unsigned)overwritten);
+            out << (first ? "" : ",\n") << "{\"name\":\"" << number << "\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << buffer.id
+                << ",\"ts\":" << Microseconds(Clock::now(), registry.start) << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+
+    if(!out)
+        throw std::runtime_error(std::string("Could not write trace file: ") + filePath);
+    return written;
+}
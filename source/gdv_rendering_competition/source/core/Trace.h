@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace core {
+
+    /**
+     Records timed sections of every thread and writes them in the Chrome Trace
+     Event Format, which chrome://tracing and ui.perfetto.dev can open.
+
+     Every thread appends to its own fixed-size ring buffer, so recording takes no
+     lock. When a ring is full, the oldest events of that thread are overwritten, so
+     a trace written late in a long session still holds its most recent frames.
+     Names and details are stored as pointers, so they must stay valid until the trace
+     is written. String literals are the usual choice.
+
+     Recording is off until setEnabled(true) is called. Profiler::Scope feeds its
+     sections into the trace automatically.
+     */
+    class Trace {
+    public:
+        static const size_t EVENTS_PER_THREAD = 1 << 18;
+
+        static void setEnabled(bool enabled);
+
+        static bool enabled();
+
+        /**
+         Names the calling thread in the trace viewer, e.g. "main" or "worker 2".
+         */
+        static void setThreadName(const char* name);
+
+        /**
+         Adds a section of the calling thread from `begin` to `end`. `detail` is optional
+         and shows up as an argument of the event, e.g. the file that was loaded.
+         */
+        static void record(const char* name,
+                           std::chrono::steady_clock::time_point begin,
+                           std::chrono::steady_clock::time_point end,
+                           const char* detail = NULL);
+
+        /**
+         Writes the last EVENTS_PER_THREAD events of every thread to `filePath`. It can be
+         called more than once while the recording goes on. Events that other threads add
+         during the call may or may not be in the file.
+
+         @return the number of events written
+         */
+        static size_t write(const std::string& filePath);
+
+    private:
+        Trace();
+    };
+}
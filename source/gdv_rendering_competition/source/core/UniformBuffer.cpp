@@ -0,0 +1,54 @@
+#include "UniformBuffer.h"
+#include <stdexcept>
+
+using namespace core;
+
+UniformBuffer::UniformBuffer(GLsizeiptr size, GLuint bindingPoint, GLenum usage) :
+    _object(0),
+    _bindingPoint(bindingPoint),
+    _size(size)
+{
+    if(size <= 0)
+        throw std::runtime_error("Uniform buffer size must be positive");
+
+    GLint maxBlockSize = 0;
+    glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxBlockSize);
+    if(size > maxBlockSize)
+        throw std::runtime_error("Uniform buffer is larger than GL_MAX_UNIFORM_BLOCK_SIZE");
+
+    glGenBuffers(1, &_object);
+    if(_object == 0)
+        throw std::runtime_error("glGenBuffers failed");
+
+    glBindBuffer(GL_UNIFORM_BUFFER, _object);
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, usage);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    //the buffer stays attached to its binding point, programs only need to know the index
+    glBindBufferBase(GL_UNIFORM_BUFFER, _bindingPoint, _object);
+}
+
+UniformBuffer::~UniformBuffer() {
+    if(_object != 0) glDeleteBuffers(1, &_object);
+}
+
+GLuint UniformBuffer::object() const {
+    return _object;
+}
+
+GLuint UniformBuffer::bindingPoint() const {
+    return _bindingPoint;
+}
+
+GLsizeiptr UniformBuffer::size() const {
+    return _size;
+}
+
+void UniformBuffer::update(const GLvoid* data, GLsizeiptr size, GLintptr offset) {
+    if(offset < 0 || offset + size > _size)
+        throw std::runtime_error("Uniform buffer update out of range");
+
+    glBindBuffer(GL_UNIFORM_BUFFER, _object);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
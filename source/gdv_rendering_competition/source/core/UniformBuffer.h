@@ -0,0 +1,31 @@
+#pragma once
+
+#include <GL/glew.h>
+
+namespace core {
+
+    class UniformBuffer {
+    public:
+
+        UniformBuffer(GLsizeiptr size, GLuint bindingPoint, GLenum usage = GL_DYNAMIC_DRAW);
+
+        ~UniformBuffer();
+
+        GLuint object() const;
+
+        GLuint bindingPoint() const;
+
+        GLsizeiptr size() const;
+
+        void update(const GLvoid* data, GLsizeiptr size, GLintptr offset = 0);
+
+    private:
+        GLuint _object;
+        GLuint _bindingPoint;
+        GLsizeiptr _size;
+
+        //copying disabled
+        UniformBuffer(const UniformBuffer&);
+        const UniformBuffer& operator=(const UniformBuffer&);
+    };
+}
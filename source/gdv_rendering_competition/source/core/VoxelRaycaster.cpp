@@ -0,0 +1,170 @@
+#include "VoxelRaycaster.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace core;
+
+namespace {
+    //collects the faces along a ray, the closest opaque face hides everything behind it
+    class FaceCollector : public VoxelScene::FaceVisitor {
+    public:
+        std::vector<VoxelScene::Face> transparentFaces;
+        VoxelScene::Face opaqueFace;
+        bool hasOpaqueFace;
+        bool sorted; //the faces arrive closest first, so the first opaque face ends the ray
+
+        void reset() {
+            transparentFaces.clear();
+            hasOpaqueFace = false;
+        }
+
+        bool visit(const VoxelScene::Face& face) {
+            if(face.material->transparent) {
+                transparentFaces.push_back(face);
+                return false;
+            }
+            if(!hasOpaqueFace || face.distance < opaqueFace.distance) {
+                opaqueFace = face;
+                hasOpaqueFace = true;
+            }
+            return sorted;
+        }
+    };
+
+    glm::vec4 Unproject(const glm::mat4& inverseCamera, float x, float y, float z) {
+        glm::vec4 p = inverseCamera * glm::vec4(x, y, z, 1.0f);
+        return p / p.w;
+    }
+}
+
+VoxelRaycaster::VoxelRaycaster(int width, int height, ThreadPool& threadPool) :
+    _width(width),
+    _height(height),
+    _threadPool(threadPool),
+    _scene(NULL),
+    _cameraPosition(0.0f),
+    _clearColor(0.0f),
+    _pixelAngle(0.0f),
+    _image((unsigned)std::max(width, 1), (unsigned)std::max(height, 1), Bitmap::Format_RGB),
+    _steps(0)
+{
+    if(width <= 0 || height <= 0)
+        throw std::runtime_error("VoxelRaycaster size must be positive");
+}
+
+int VoxelRaycaster::width() const
+{
+    return _width;
+}
+
+int VoxelRaycaster::height() const
+{
+    return _height;
+}
+
+void VoxelRaycaster::setTextures(const std::vector<Bitmap>& layers)
+{
+    _shading.setTextures(layers);
+}
+
+void VoxelRaycaster::beginFrame(const glm::mat4& camera, const glm::vec3& cameraPosition,
+                                const std::vector<Light>& lights, const glm::vec3& clearColor)
+{
+    _shading.setLights(lights, cameraPosition);
+    _inverseCamera = glm::inverse(camera);
+    _cameraPosition = cameraPosition;
+    _clearColor = clearColor;
+
+    //the chord between two neighbouring rays in the middle of the image is close enough to the angle
+    Ray center = _pixelRay(_width / 2, _height / 2);
+    Ray below = _pixelRay(_width / 2, _height / 2 + 1);
+    _pixelAngle = glm::length(below.direction - center.direction);
+}
+
+void VoxelRaycaster::render(const VoxelScene& scene)
+{
+    _scene = &scene;
+    _steps = 0;
+    _threadPool.parallelFor((size_t)_height, [this](size_t y) {
+        _renderRow((int)y);
+    });
+}
+
+uint64_t VoxelRaycaster::stepCount() const
+{
+    return _steps;
+}
+
+Bitmap VoxelRaycaster::readPixels() const
+{
+    return _image;
+}
+
+VoxelRaycaster::Ray VoxelRaycaster::_pixelRay(int x, int y) const
+{
+    float ndcX = ((float)x + 0.5f) / (float)_width * 2.0f - 1.0f;
+    float ndcY = 1.0f - ((float)y + 0.5f) / (float)_height * 2.0f;
+    glm::vec3 nearPoint(Unproject(_inverseCamera, ndcX, ndcY, -1.0f));
+    glm::vec3 farPoint(Unproject(_inverseCamera, ndcX, ndcY, 1.0f));
+
+    Ray ray;
+    ray.origin = nearPoint;
+    ray.length = glm::length(farPoint - nearPoint);
+    ray.direction = (farPoint - nearPoint) / ray.length;
+    return ray;
+}
+
+void VoxelRaycaster::_renderRow(int y)
+{
+    FaceCollector faces;
+    uint64_t steps = 0;
+    unsigned char* row = _image.pixelBuffer() + (size_t)y * _width * 3;
+    for(int x = 0; x < _width; ++x) {
+        Ray ray = _pixelRay(x, y);
+        faces.reset();
+
+        //the boxes first, the closest opaque one shortens the walk through the blocks
+        faces.sorted = false;
+        _scene->traceBoxes(ray.origin, ray.direction, ray.length, faces);
+        faces.sorted = true;
+        steps += _scene->traceBlocks(ray.origin, ray.direction, faces.hasOpaqueFace ? faces.opaqueFace.distance : ray.length, faces);
+
+        glm::vec3 color = _clearColor;
+        float distance = ray.length;
+        if(faces.hasOpaqueFace) {
+            color = glm::vec3(_shadeFace(ray, faces.opaqueFace));
+            distance = faces.opaqueFace.distance;
+        }
+
+        //the transparent surfaces in front of the opaque one, blended like GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA from back to front
+        std::vector<VoxelScene::Face>& layers = faces.transparentFaces;
+        std::sort(layers.begin(), layers.end(), [](const VoxelScene::Face& a, const VoxelScene::Face& b) { return a.distance > b.distance; });
+        for(size_t i = 0; i < layers.size(); ++i) {
+            if(layers[i].distance < distance) {
+                glm::vec4 layerColor = _shadeFace(ray, layers[i]);
+                color = glm::mix(color, glm::vec3(layerColor), layerColor.a);
+            }
+        }
+
+        glm::vec3 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+        row[x * 3 + 0] = (unsigned char)c.r;
+        row[x * 3 + 1] = (unsigned char)c.g;
+        row[x * 3 + 2] = (unsigned char)c.b;
+    }
+    _steps += steps;
+}
+
+glm::vec4 VoxelRaycaster::_shadeFace(const Ray& ray, const VoxelScene::Face& face) const
+{
+    glm::vec3 position = ray.origin + ray.direction * face.distance;
+
+    //the footprint of the pixel on the face, stretched where the face is seen at a flat angle
+    float cosine = std::max(std::abs(glm::dot(ray.direction, face.normal)), 0.01f);
+    float footprint = glm::length(position - _cameraPosition) * _pixelAngle / cosine;
+    glm::vec2 size = _shading.textureSize(face.material->textureLayer);
+    float texels = footprint * face.texCoordsPerUnit * std::max(size.x, size.y);
+    float lod = (texels > 0.0f) ? std::log2(texels) : 0.0f;
+
+    return _shading.shade(*face.material, position, face.normal, face.texCoord, lod);
+}
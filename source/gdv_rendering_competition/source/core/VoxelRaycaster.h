@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "Bitmap.h"
+#include "Shading.h"
+#include "ThreadPool.h"
+#include "VoxelScene.h"
+
+namespace core {
+
+    /**
+     Renders a VoxelScene on the CPU by casting one ray per pixel through the
+     block grid, instead of drawing the faces of the blocks. The cost depends on
+     the number of pixels and how far the rays travel, not on the number of blocks.
+
+     The first opaque face ends the ray, transparent faces are blended in front
+     of it. Hits are shaded by Shading with the texture coordinates of the
+     mesher's faces, so the image matches the meshed terrain.
+
+     The rows are handed out to the threads of the pool one at a time, so threads
+     that finish early take over the rows that are still left.
+     */
+    class VoxelRaycaster {
+    public:
+        typedef Shading::Material Material;
+        typedef Shading::Light Light;
+
+        VoxelRaycaster(int width, int height, ThreadPool& threadPool);
+
+        int width() const;
+
+        int height() const;
+
+        /**
+         Sets the texture layers the materials refer to, see Shading::setTextures().
+         */
+        void setTextures(const std::vector<Bitmap>& layers);
+
+        /**
+         Starts a new frame. `camera` is the projection and view matrix, its near and far
+         planes limit the rays like they clip the OpenGL image.
+         */
+        void beginFrame(const glm::mat4& camera, const glm::vec3& cameraPosition,
+                        const std::vector<Light>& lights, const glm::vec3& clearColor);
+
+        /**
+         Casts the rays of all pixels into `scene`.
+         */
+        void render(const VoxelScene& scene);
+
+        /**
+         @return the number of blocks the rays of the last frame stepped through
+         */
+        uint64_t stepCount() const;
+
+        /**
+         The image of the last frame, RGB with the top row first like Framebuffer::readPixels().
+         */
+        Bitmap readPixels() const;
+
+    private:
+        //the ray of one pixel, in world space
+        struct Ray {
+            glm::vec3 origin;    //on the near plane
+            glm::vec3 direction; //normalized
+            float length;        //to the far plane
+        };
+
+        int _width;
+        int _height;
+        ThreadPool& _threadPool;
+
+        Shading _shading;
+        const VoxelScene* _scene;
+
+        glm::mat4 _inverseCamera;
+        glm::vec3 _cameraPosition;
+        glm::vec3 _clearColor;
+        float _pixelAngle; //angle between the rays of neighbouring pixels
+
+        Bitmap _image;
+        std::atomic<uint64_t> _steps;
+
+        Ray _pixelRay(int x, int y) const;
+        void _renderRow(int y);
+
+        glm::vec4 _shadeFace(const Ray& ray, const VoxelScene::Face& face) const;
+
+        //copying disabled
+        VoxelRaycaster(const VoxelRaycaster&);
+        const VoxelRaycaster& operator=(const VoxelRaycaster&);
+    };
+}
@@ -0,0 +1,453 @@
+#include "VoxelScene.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VOXELSCENE_SSE2
+#endif
+
+using namespace core;
+
+namespace {
+    //how the texture is laid on a face, the same as the faces of ChunkMesher and CUBE_VERTEX_DATA
+    struct FaceMapping {
+        int uAxis;
+        int vAxis;
+        bool flipU; //u goes from 1 to 0 along uAxis
+    };
+
+    //indexed by axis * 2 + (normal points in the positive direction ? 1 : 0)
+    const FaceMapping FACE_MAPPINGS[6] = {
+        { 1, 2, false }, // left
+        { 1, 2, true  }, // right
+        { 0, 2, false }, // bottom
+        { 0, 2, false }, // top
+        { 0, 1, false }, // back
+        { 0, 1, true  }  // front
+    };
+
+    int FloorToInt(float value) {
+        return (int)std::floor(value);
+    }
+
+    //`faceCoord` is the position on the face inside the block or box, from 0 to 1 along every axis
+    glm::vec2 FaceTexCoord(int axis, bool positive, const glm::vec3& faceCoord) {
+        const FaceMapping& mapping = FACE_MAPPINGS[axis * 2 + (positive ? 1 : 0)];
+        float u = faceCoord[mapping.uAxis];
+        return glm::vec2(mapping.flipU ? 1.0f - u : u, faceCoord[mapping.vAxis]);
+    }
+
+    //slab test of a ray against the box from `boxMin` to `boxMax`, `enterAxis` is the axis of the face it enters through
+    bool IntersectBox(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& boxMin, const glm::vec3& boxMax,
+                      float& tEnter, float& tExit, int& enterAxis) {
+        tEnter = -FLT_MAX;
+        tExit = FLT_MAX;
+        enterAxis = -1;
+        for(int axis = 0; axis < 3; ++axis) {
+            if(direction[axis] == 0.0f) {
+                if(origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis])
+                    return false;
+                continue;
+            }
+            float t0 = (boxMin[axis] - origin[axis]) / direction[axis];
+            float t1 = (boxMax[axis] - origin[axis]) / direction[axis];
+            if(t0 > t1)
+                std::swap(t0, t1);
+            if(t0 > tEnter) {
+                tEnter = t0;
+                enterAxis = axis;
+            }
+            tExit = std::min(tExit, t1);
+        }
+        return tEnter <= tExit && tExit >= 0.0f;
+    }
+}
+
+VoxelScene::VoxelScene() :
+    _world(NULL),
+    _blockSize(1.0f),
+    _worldMin(0),
+    _worldMax(-1),
+    _chunkGridFirst(0),
+    _chunkGridSize(0),
+    _boxesMin(FLT_MAX),
+    _boxesMax(-FLT_MAX)
+{
+    for(int id = 0; id < 256; ++id) {
+        _blocks[id].textureLayer = 0;
+        _blocks[id].shininess = 1.0f;
+        _blocks[id].specularColor = glm::vec3(0.0f);
+        _blocks[id].transparent = false;
+    }
+}
+
+void VoxelScene::setBlock(VoxelWorld::BlockId id, const Material& material)
+{
+    if(material.textureLayer < 0)
+        throw std::runtime_error("Block material needs a texture layer");
+    _blocks[id] = material;
+}
+
+void VoxelScene::setWorld(const VoxelWorld& world, float blockSize)
+{
+    if(blockSize <= 0.0f)
+        throw std::runtime_error("Block size must be positive");
+
+    _world = &world;
+    _blockSize = blockSize;
+
+    //the rays only have to walk through the bounding box of all blocks
+    _worldMin = glm::ivec3(INT_MAX);
+    _worldMax = glm::ivec3(INT_MIN);
+    const std::vector<VoxelWorld::Chunk*>& chunks = world.chunks();
+    for(size_t i = 0; i < chunks.size(); ++i) {
+        const VoxelWorld::Chunk& chunk = *chunks[i];
+        if(chunk.solidCount == 0)
+            continue;
+        glm::ivec3 origin = glm::ivec3(chunk.coord.x, chunk.coord.y, chunk.coord.z) * VoxelWorld::CHUNK_SIZE;
+        _worldMin = glm::min(_worldMin, origin + glm::ivec3(chunk.solidMin[0], chunk.solidMin[1], chunk.solidMin[2]));
+        _worldMax = glm::max(_worldMax, origin + glm::ivec3(chunk.solidMax[0], chunk.solidMax[1], chunk.solidMax[2]));
+    }
+
+    //the chunks inside these bounds in a flat array, which is much faster to look up than the map of the world
+    _chunkGrid.clear();
+    if(_worldMin.x <= _worldMax.x) {
+        VoxelWorld::ChunkCoord first = VoxelWorld::chunkCoordOf(_worldMin.x, _worldMin.y, _worldMin.z);
+        VoxelWorld::ChunkCoord last = VoxelWorld::chunkCoordOf(_worldMax.x, _worldMax.y, _worldMax.z);
+        _chunkGridFirst = glm::ivec3(first.x, first.y, first.z);
+        _chunkGridSize = glm::ivec3(last.x - first.x + 1, last.y - first.y + 1, last.z - first.z + 1);
+        _chunkGrid.resize((size_t)_chunkGridSize.x * _chunkGridSize.y * _chunkGridSize.z, NULL);
+        for(size_t i = 0; i < chunks.size(); ++i) {
+            const VoxelWorld::Chunk& chunk = *chunks[i];
+            glm::ivec3 coord = glm::ivec3(chunk.coord.x - first.x, chunk.coord.y - first.y, chunk.coord.z - first.z);
+            if(chunk.solidCount > 0)
+                _chunkGrid[((size_t)coord.y * _chunkGridSize.z + coord.z) * _chunkGridSize.x + coord.x] = &chunk;
+        }
+    }
+}
+
+void VoxelScene::clearBoxes()
+{
+    _boxes.clear();
+    _boxGroups.clear();
+    _boxesMin = glm::vec3(FLT_MAX);
+    _boxesMax = glm::vec3(-FLT_MAX);
+}
+
+void VoxelScene::addBox(const glm::mat4& model, const Material& material)
+{
+    if(material.textureLayer < 0)
+        throw std::runtime_error("Box material needs a texture layer");
+
+    Box box;
+    box.worldToLocal = glm::inverse(model);
+    box.material = material;
+    _boxes.push_back(box);
+
+    for(int corner = 0; corner < 8; ++corner) {
+        glm::vec4 local((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f, 1.0f);
+        glm::vec3 world(model * local);
+        _boxesMin = glm::min(_boxesMin, world);
+        _boxesMax = glm::max(_boxesMax, world);
+    }
+
+    //the unused lanes of the last group are zero and never reported
+    if(_boxGroups.empty() || _boxGroups.back().count == 4) {
+        BoxGroup group;
+        std::fill(&group.rows[0][0], &group.rows[0][0] + 12 * 4, 0.0f);
+        group.count = 0;
+        _boxGroups.push_back(group);
+    }
+    BoxGroup& group = _boxGroups.back();
+    for(int row = 0; row < 3; ++row) {
+        for(int column = 0; column < 4; ++column)
+            group.rows[row * 4 + column][group.count] = box.worldToLocal[column][row];
+    }
+    ++group.count;
+}
+
+size_t VoxelScene::boxCount() const
+{
+    return _boxes.size();
+}
+
+unsigned VoxelScene::traceBlocks(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float maxDistance, FaceVisitor& visitor) const
+{
+    if(_world == NULL || _worldMin.x > _worldMax.x)
+        return 0;
+
+    //in grid coordinates block (x, y, z) goes from (x, y, z) to (x + 1, y + 1, z + 1), t stays in world units
+    const glm::vec3 origin = rayOrigin / _blockSize + 0.5f;
+    const glm::vec3 direction = rayDirection / _blockSize;
+    const float texCoordsPerUnit = 1.0f / _blockSize;
+
+    //clip the ray to the bounding box of the world
+    float tEnter, tExit;
+    int enterAxis;
+    if(!IntersectBox(origin, direction, glm::vec3(_worldMin), glm::vec3(_worldMax + 1), tEnter, tExit, enterAxis))
+        return 0;
+    if(tEnter < 0.0f) {
+        tEnter = 0.0f;
+        enterAxis = -1;
+    }
+    tExit = std::min(tExit, maxDistance);
+    if(tEnter > tExit)
+        return 0;
+
+    glm::ivec3 step, cell;
+    glm::vec3 tMax, tDelta;
+    for(int axis = 0; axis < 3; ++axis) {
+        step[axis] = (direction[axis] > 0.0f) ? 1 : (direction[axis] < 0.0f ? -1 : 0);
+        cell[axis] = glm::clamp(FloorToInt(origin[axis] + direction[axis] * tEnter), _worldMin[axis], _worldMax[axis]);
+        tDelta[axis] = (step[axis] != 0) ? 1.0f / std::abs(direction[axis]) : FLT_MAX;
+    }
+
+    //a ray that starts inside a block does not see that block, there is no face before the first step then
+    VoxelWorld::BlockId previous = VoxelWorld::EMPTY;
+
+    //the chunk `cell` is in and the bounds of its blocks, looked up again when the ray leaves the chunk
+    const VoxelWorld::Chunk* chunk = NULL;
+    glm::ivec3 chunkMin(INT_MAX - VoxelWorld::CHUNK_SIZE);
+    glm::ivec3 solidMin(0), solidMax(-1);
+
+    unsigned steps = 0;
+    float t = tEnter;
+    int axis = enterAxis;
+    bool resetTMax = true;
+    while(t <= tExit) {
+        ++steps;
+        if(resetTMax) {
+            for(int a = 0; a < 3; ++a)
+                tMax[a] = (step[a] != 0) ? ((float)(cell[a] + (step[a] > 0 ? 1 : 0)) - origin[a]) / direction[a] : FLT_MAX;
+            resetTMax = false;
+        }
+
+        if(glm::any(glm::lessThan(cell, chunkMin)) || glm::any(glm::greaterThanEqual(cell, chunkMin + VoxelWorld::CHUNK_SIZE))) {
+            VoxelWorld::ChunkCoord chunkCoord = VoxelWorld::chunkCoordOf(cell.x, cell.y, cell.z);
+            glm::ivec3 coord(chunkCoord.x, chunkCoord.y, chunkCoord.z);
+            chunkMin = coord * VoxelWorld::CHUNK_SIZE;
+            coord -= _chunkGridFirst;
+            chunk = NULL;
+            if(glm::all(glm::greaterThanEqual(coord, glm::ivec3(0))) && glm::all(glm::lessThan(coord, _chunkGridSize)))
+                chunk = _chunkGrid[((size_t)coord.y * _chunkGridSize.z + coord.z) * _chunkGridSize.x + coord.x];
+            if(chunk != NULL && chunk->solidCount > 0) {
+                solidMin = chunkMin + glm::ivec3(chunk->solidMin[0], chunk->solidMin[1], chunk->solidMin[2]);
+                solidMax = chunkMin + glm::ivec3(chunk->solidMax[0], chunk->solidMax[1], chunk->solidMax[2]);
+            } else {
+                solidMin = glm::ivec3(0);
+                solidMax = glm::ivec3(-1);
+            }
+        }
+
+        bool inSolidBounds = glm::all(glm::greaterThanEqual(cell, solidMin)) && glm::all(glm::lessThanEqual(cell, solidMax));
+        VoxelWorld::BlockId id = VoxelWorld::EMPTY;
+        if(inSolidBounds) {
+            glm::ivec3 local = cell - chunkMin;
+            id = chunk->get(local.x, local.y, local.z);
+        }
+
+        if(id != previous && axis >= 0) {
+            glm::vec3 faceCoord = origin + direction * t - glm::vec3(cell);
+            Face face;
+            face.distance = t;
+            face.normal = glm::vec3(0.0f);
+            face.texCoordsPerUnit = texCoordsPerUnit;
+
+            //the face of the block the ray leaves, then the one of the block it enters
+            if(previous != VoxelWorld::EMPTY && _faceVisible(previous, id)) {
+                face.normal[axis] = (float)step[axis];
+                face.texCoord = FaceTexCoord(axis, step[axis] > 0, faceCoord);
+                face.material = &_blocks[previous];
+                if(visitor.visit(face))
+                    return steps;
+            }
+            if(id != VoxelWorld::EMPTY && _faceVisible(id, previous)) {
+                face.normal[axis] = (float)-step[axis];
+                face.texCoord = FaceTexCoord(axis, step[axis] < 0, faceCoord);
+                face.material = &_blocks[id];
+                if(visitor.visit(face))
+                    return steps;
+            }
+        }
+        previous = id;
+
+        if(!inSolidBounds) {
+            //everything up to the blocks of this chunk or the next chunk is empty, jump there
+            glm::ivec3 landMin, landMax;
+            float tIn, tOut;
+            int inAxis;
+            const float epsilon = 1e-4f;
+            if(solidMin.x <= solidMax.x && IntersectBox(origin, direction, glm::vec3(solidMin), glm::vec3(solidMax + 1), tIn, tOut, inAxis) &&
+               tIn >= t - epsilon && tOut > t + epsilon && inAxis >= 0) {
+                t = std::max(t, tIn);
+                axis = inAxis;
+                landMin = solidMin;
+                landMax = solidMax;
+                cell[axis] = (step[axis] > 0) ? solidMin[axis] : solidMax[axis];
+            } else {
+                float tNext = FLT_MAX;
+                int nextAxis = -1;
+                for(int a = 0; a < 3; ++a) {
+                    if(step[a] == 0)
+                        continue;
+                    float tb = ((float)(chunkMin[a] + ((step[a] > 0) ? VoxelWorld::CHUNK_SIZE : 0)) - origin[a]) / direction[a];
+                    if(tb < tNext) {
+                        tNext = tb;
+                        nextAxis = a;
+                    }
+                }
+                if(nextAxis < 0)
+                    break;
+
+                t = std::max(t, tNext);
+                axis = nextAxis;
+                landMin = chunkMin;
+                landMax = chunkMin + VoxelWorld::CHUNK_SIZE - 1;
+                cell[axis] = (step[axis] > 0) ? chunkMin[axis] + VoxelWorld::CHUNK_SIZE : chunkMin[axis] - 1;
+            }
+
+            for(int a = 0; a < 3; ++a) {
+                if(a != axis)
+                    cell[a] = glm::clamp(FloorToInt(origin[a] + direction[a] * t), landMin[a], landMax[a]);
+            }
+            resetTMax = true;
+            continue;
+        }
+
+        //the next block is behind the closest of the three boundaries
+        axis = (tMax.x < tMax.y) ? ((tMax.x < tMax.z) ? 0 : 2) : ((tMax.y < tMax.z) ? 1 : 2);
+        t = tMax[axis];
+        cell[axis] += step[axis];
+        tMax[axis] += tDelta[axis];
+    }
+
+    return steps;
+}
+
+void VoxelScene::traceBoxes(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, FaceVisitor& visitor) const
+{
+    if(_boxes.empty())
+        return;
+
+    //most rays miss all boxes, like the car that is small on the screen
+    float tEnter, tExit;
+    int enterAxis;
+    if(!IntersectBox(origin, direction, _boxesMin, _boxesMax, tEnter, tExit, enterAxis) || tEnter >= maxDistance)
+        return;
+
+#ifdef VOXELSCENE_SSE2
+    const __m128 ox = _mm_set1_ps(origin.x);
+    const __m128 oy = _mm_set1_ps(origin.y);
+    const __m128 oz = _mm_set1_ps(origin.z);
+    const __m128 dx = _mm_set1_ps(direction.x);
+    const __m128 dy = _mm_set1_ps(direction.y);
+    const __m128 dz = _mm_set1_ps(direction.z);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 farthest = _mm_set1_ps(maxDistance);
+
+    for(size_t g = 0; g < _boxGroups.size(); ++g) {
+        const BoxGroup& group = _boxGroups[g];
+
+        //the slab test of the -1 to 1 cube in the local space of four boxes at once
+        __m128 tNear = _mm_set1_ps(-FLT_MAX);
+        __m128 tFar = _mm_set1_ps(FLT_MAX);
+        for(int axis = 0; axis < 3; ++axis) {
+            const __m128 m0 = _mm_loadu_ps(group.rows[axis * 4 + 0]);
+            const __m128 m1 = _mm_loadu_ps(group.rows[axis * 4 + 1]);
+            const __m128 m2 = _mm_loadu_ps(group.rows[axis * 4 + 2]);
+            const __m128 m3 = _mm_loadu_ps(group.rows[axis * 4 + 3]);
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, dx), _mm_mul_ps(m1, dy)), _mm_mul_ps(m2, dz));
+            __m128 o = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, ox), _mm_mul_ps(m1, oy)), _mm_mul_ps(m2, oz)), m3);
+            __m128 inverse = _mm_div_ps(one, d);
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(minusOne, o), inverse);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(one, o), inverse);
+            tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+            tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+        }
+        __m128 hit = _mm_and_ps(_mm_cmple_ps(tNear, tFar), _mm_and_ps(_mm_cmpge_ps(tFar, zero), _mm_cmplt_ps(tNear, farthest)));
+        int lanes = _mm_movemask_ps(hit) & ((1 << group.count) - 1);
+
+        //the faces are only worked out for the boxes that are hit
+        for(unsigned lane = 0; lanes != 0; ++lane, lanes >>= 1) {
+            if((lanes & 1) && _boxFaces(_boxes[g * 4 + lane], origin, direction, maxDistance, visitor))
+                return;
+        }
+    }
+#else
+    for(size_t i = 0; i < _boxes.size(); ++i) {
+        if(_boxFaces(_boxes[i], origin, direction, maxDistance, visitor))
+            return;
+    }
+#endif
+}
+
+bool VoxelScene::_faceVisible(VoxelWorld::BlockId id, VoxelWorld::BlockId neighbour) const
+{
+    //the same rule as ChunkMesher
+    if(neighbour == VoxelWorld::EMPTY)
+        return true;
+    if(!_blocks[neighbour].transparent)
+        return false;
+    return neighbour != id;
+}
+
+bool VoxelScene::_boxFaces(const Box& box, const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float maxDistance, FaceVisitor& visitor) const
+{
+    //the direction is not normalized in local space, so t stays the world distance
+    glm::vec3 origin(box.worldToLocal * glm::vec4(rayOrigin, 1.0f));
+    glm::vec3 direction(glm::mat3(box.worldToLocal) * rayDirection);
+
+    float tNear = -FLT_MAX;
+    float tFar = FLT_MAX;
+    int nearAxis = -1;
+    int farAxis = -1;
+    for(int axis = 0; axis < 3; ++axis) {
+        if(direction[axis] == 0.0f) {
+            if(origin[axis] < -1.0f || origin[axis] > 1.0f)
+                return false;
+            continue;
+        }
+        float t0 = (-1.0f - origin[axis]) / direction[axis];
+        float t1 = (1.0f - origin[axis]) / direction[axis];
+        if(t0 > t1)
+            std::swap(t0, t1);
+        if(t0 > tNear) {
+            tNear = t0;
+            nearAxis = axis;
+        }
+        if(t1 < tFar) {
+            tFar = t1;
+            farAxis = axis;
+        }
+    }
+    if(tNear > tFar || tFar < 0.0f || nearAxis < 0)
+        return false;
+
+    //no face culling in Render(), so the inside of a box can be seen too
+    const glm::mat3 normalMatrix = glm::transpose(glm::mat3(box.worldToLocal));
+    Face face;
+    face.texCoordsPerUnit = 0.5f * glm::length(direction);
+    face.material = &box.material;
+    for(int side = 0; side < 2; ++side) {
+        float t = (side == 0) ? tNear : tFar;
+        int axis = (side == 0) ? nearAxis : farAxis;
+        if(t < 0.0f || t >= maxDistance)
+            continue;
+
+        glm::vec3 localNormal(0.0f);
+        localNormal[axis] = ((direction[axis] > 0.0f) == (side == 1)) ? 1.0f : -1.0f;
+        glm::vec3 faceCoord = glm::clamp((origin + direction * t) * 0.5f + 0.5f, 0.0f, 1.0f);
+        face.distance = t;
+        face.normal = glm::normalize(normalMatrix * localNormal);
+        face.texCoord = FaceTexCoord(axis, localNormal[axis] > 0.0f, faceCoord);
+        if(visitor.visit(face))
+            return true;
+    }
+    return false;
+}
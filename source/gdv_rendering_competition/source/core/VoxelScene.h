@@ -0,0 +1,117 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "Shading.h"
+#include "VoxelWorld.h"
+
+namespace core {
+
+    /**
+     The blocks of a VoxelWorld plus loose boxes like the car, prepared for
+     tracing rays through them on the CPU. The VoxelRaycaster and the PathTracer
+     both find their surfaces here.
+
+     Rays walk from block to block with a 3D DDA (Amanatides & Woo). Chunks
+     without blocks are skipped as a whole, in the others the ray jumps straight
+     to the bounds of their blocks. The faces a ray passes are the ones the
+     ChunkMesher would emit, with the same texture coordinates.
+
+     The boxes are kept four at a time in columns, so one ray is tested against
+     four boxes at once with SSE2 where it is available.
+
+     Tracing is const, so any number of threads can trace at the same time.
+     */
+    class VoxelScene {
+    public:
+        typedef Shading::Material Material;
+
+        //a face of a block or box that a ray passes through
+        struct Face {
+            float distance;         //along the ray
+            glm::vec3 normal;       //normalized, points out of the block or box
+            glm::vec2 texCoord;
+            float texCoordsPerUnit; //change of the texture coordinates per world unit, for the texture LOD
+            const Material* material;
+        };
+
+        //receives the faces along a ray
+        class FaceVisitor {
+        public:
+            virtual ~FaceVisitor() {}
+
+            /**
+             @return true to stop tracing the ray
+             */
+            virtual bool visit(const Face& face) = 0;
+        };
+
+        VoxelScene();
+
+        /**
+         Sets how blocks of type `id` look. Blocks without a material use texture layer 0.
+         */
+        void setBlock(VoxelWorld::BlockId id, const Material& material);
+
+        /**
+         Uses the blocks of `world`, block (x, y, z) is a cube with edges of `blockSize`
+         around (x, y, z) * blockSize. Has to be called again when the world changes,
+         and `world` has to stay alive while the scene is used.
+         */
+        void setWorld(const VoxelWorld& world, float blockSize);
+
+        void clearBoxes();
+
+        /**
+         Adds a box, `model` transforms the cube from -1 to 1 into world space. The faces
+         have the texture coordinates of CUBE_VERTEX_DATA.
+         */
+        void addBox(const glm::mat4& model, const Material& material);
+
+        size_t boxCount() const;
+
+        /**
+         Calls `visitor` for the visible block faces along the ray, the closest first,
+         until it returns true or the ray is `maxDistance` long. `direction` is normalized.
+
+         @return the number of blocks the ray stepped through
+         */
+        unsigned traceBlocks(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, FaceVisitor& visitor) const;
+
+        /**
+         Calls `visitor` for the faces where the ray enters or leaves a box before
+         `maxDistance`, until it returns true. The faces are not sorted by distance.
+         */
+        void traceBoxes(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, FaceVisitor& visitor) const;
+
+    private:
+        struct Box {
+            glm::mat4 worldToLocal;
+            Material material;
+        };
+
+        //the rows of the world to local matrices of four boxes, lane i is box 4 * group + i
+        struct BoxGroup {
+            float rows[12][4]; //m[row][column] at index row * 4 + column, only the first three rows
+            unsigned count;
+        };
+
+        Material _blocks[256];
+
+        const VoxelWorld* _world;
+        float _blockSize;
+        glm::ivec3 _worldMin; //blocks, inclusive
+        glm::ivec3 _worldMax;
+        std::vector<const VoxelWorld::Chunk*> _chunkGrid; //NULL for chunks without blocks
+        glm::ivec3 _chunkGridFirst; //chunk coordinates of the first chunk
+        glm::ivec3 _chunkGridSize;  //in chunks
+
+        std::vector<Box> _boxes;
+        std::vector<BoxGroup> _boxGroups;
+        glm::vec3 _boxesMin; //world space bounds of all boxes
+        glm::vec3 _boxesMax;
+
+        bool _faceVisible(VoxelWorld::BlockId id, VoxelWorld::BlockId neighbour) const;
+        bool _boxFaces(const Box& box, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, FaceVisitor& visitor) const;
+    };
+}
@@ -0,0 +1,112 @@
+#include "VoxelWorld.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace core;
+
+//integer division that rounds towards negative infinity, so -1 lands in chunk -1
+static inline int FloorDiv(int value, int divisor) {
+    return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+VoxelWorld::BlockId VoxelWorld::Chunk::get(int localX, int localY, int localZ) const {
+    return blocks[localIndex(localX, localY, localZ)];
+}
+
+VoxelWorld::VoxelWorld() :
+    _blockCount(0)
+{
+}
+
+VoxelWorld::~VoxelWorld() {
+    clear();
+}
+
+VoxelWorld::BlockId VoxelWorld::get(int x, int y, int z) const {
+    ChunkCoord coord = chunkCoordOf(x, y, z);
+    const Chunk* c = chunk(coord);
+    if(!c)
+        return EMPTY;
+
+    return c->get(x - coord.x * CHUNK_SIZE, y - coord.y * CHUNK_SIZE, z - coord.z * CHUNK_SIZE);
+}
+
+void VoxelWorld::set(int x, int y, int z, BlockId id) {
+    ChunkCoord coord = chunkCoordOf(x, y, z);
+    uint64_t key = _key(coord);
+
+    Chunk* c = NULL;
+    std::unordered_map<uint64_t, Chunk*>::iterator it = _chunkMap.find(key);
+    if(it != _chunkMap.end()) {
+        c = it->second;
+    } else {
+        if(id == EMPTY)
+            return; //no need to allocate a chunk just to keep it empty
+
+        c = new Chunk();
+        c->coord = coord;
+        c->solidCount = 0;
+        for(int axis = 0; axis < 3; ++axis) {
+            c->solidMin[axis] = CHUNK_SIZE;
+            c->solidMax[axis] = -1;
+        }
+        memset(c->blocks, EMPTY, sizeof(c->blocks));
+        _chunkMap[key] = c;
+        _chunks.push_back(c);
+    }
+
+    const int local[3] = { x - coord.x * CHUNK_SIZE, y - coord.y * CHUNK_SIZE, z - coord.z * CHUNK_SIZE };
+    BlockId& block = c->blocks[localIndex(local[0], local[1], local[2])];
+    if(block == EMPTY && id != EMPTY) {
+        ++c->solidCount;
+        ++_blockCount;
+        for(int axis = 0; axis < 3; ++axis) {
+            c->solidMin[axis] = std::min(c->solidMin[axis], local[axis]);
+            c->solidMax[axis] = std::max(c->solidMax[axis], local[axis]);
+        }
+    } else if(block != EMPTY && id == EMPTY) {
+        --c->solidCount;
+        --_blockCount;
+    }
+    block = id;
+}
+
+void VoxelWorld::clear() {
+    for(size_t i = 0; i < _chunks.size(); ++i)
+        delete _chunks[i];
+
+    _chunks.clear();
+    _chunkMap.clear();
+    _blockCount = 0;
+}
+
+const VoxelWorld::Chunk* VoxelWorld::chunk(const ChunkCoord& coord) const {
+    std::unordered_map<uint64_t, Chunk*>::const_iterator it = _chunkMap.find(_key(coord));
+    return (it != _chunkMap.end()) ? it->second : NULL;
+}
+
+const std::vector<VoxelWorld::Chunk*>& VoxelWorld::chunks() const {
+    return _chunks;
+}
+
+size_t VoxelWorld::blockCount() const {
+    return _blockCount;
+}
+
+VoxelWorld::ChunkCoord VoxelWorld::chunkCoordOf(int x, int y, int z) {
+    ChunkCoord coord;
+    coord.x = FloorDiv(x, CHUNK_SIZE);
+    coord.y = FloorDiv(y, CHUNK_SIZE);
+    coord.z = FloorDiv(z, CHUNK_SIZE);
+    return coord;
+}
+
+int VoxelWorld::localIndex(int localX, int localY, int localZ) {
+    return (localY * CHUNK_SIZE + localZ) * CHUNK_SIZE + localX;
+}
+
+uint64_t VoxelWorld::_key(const ChunkCoord& coord) {
+    //21 bits per axis is plenty, chunk coordinates are block coordinates / CHUNK_SIZE
+    const uint64_t mask = (1u << 21) - 1;
+    return ((uint64_t)(coord.x & mask) << 42) | ((uint64_t)(coord.y & mask) << 21) | (uint64_t)(coord.z & mask);
+}
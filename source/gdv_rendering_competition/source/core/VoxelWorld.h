@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+namespace core {
+
+    /**
+     Dense block storage for a sparse world. The world is split into chunks of
+     CHUNK_SIZE^3 blocks, every block is a single byte id (0 = empty), and chunks
+     are only allocated once a block is placed in them.
+     */
+    class VoxelWorld {
+    public:
+        typedef uint8_t BlockId;
+
+        static const BlockId EMPTY = 0;
+        static const int CHUNK_SIZE = 16;
+        static const int CHUNK_VOLUME = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+        struct ChunkCoord {
+            int x, y, z;
+        };
+
+        struct Chunk {
+            ChunkCoord coord;
+            unsigned solidCount;
+            int solidMin[3]; //local coordinates of the blocks, inclusive. Removing a block does not
+            int solidMax[3]; //shrink them, so they can be larger than needed but never too small
+            BlockId blocks[CHUNK_VOLUME];
+
+            BlockId get(int localX, int localY, int localZ) const;
+        };
+
+        VoxelWorld();
+        ~VoxelWorld();
+
+        BlockId get(int x, int y, int z) const;
+
+        void set(int x, int y, int z, BlockId id);
+
+        void clear();
+
+        const Chunk* chunk(const ChunkCoord& coord) const; //NULL if nothing was ever placed there
+
+        const std::vector<Chunk*>& chunks() const;
+
+        size_t blockCount() const;
+
+        static ChunkCoord chunkCoordOf(int x, int y, int z);
+
+        static int localIndex(int localX, int localY, int localZ);
+
+    private:
+        std::unordered_map<uint64_t, Chunk*> _chunkMap;
+        std::vector<Chunk*> _chunks;
+        size_t _blockCount;
+
+        static uint64_t _key(const ChunkCoord& coord);
+
+        //copying disabled
+        VoxelWorld(const VoxelWorld&);
+        const VoxelWorld& operator=(const VoxelWorld&);
+    };
+}
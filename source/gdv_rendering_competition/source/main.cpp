@@ -6,37 +6,113 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "core/Program.h"
-#include "core/Texture.h"
+#include "core/TextureArray.h"
+#include "core/BitmapLoader.h"
+#include "core/TextureFile.h"
+#include "core/Framebuffer.h"
+#include "core/OffscreenContext.h"
 #include "core/Camera.h"
+#include "core/UniformBuffer.h"
+#include "core/PathTracer.h"
+#include "core/VoxelRaycaster.h"
+#include "core/VoxelWorld.h"
+#include "core/ChunkMesher.h"
+#include "core/Frustum.h"
+#include "core/Profiler.h"
+#include "core/Trace.h"
+#include "core/CameraPath.h"
+#include "core/Rasterizer.h"
+#include "core/ThreadPool.h"
+#include "core/SceneGraph.h"
+#include "core/FixedTimestep.h"
+#include "core/FramePipeline.h"
+#include "core/JobSystem.h"
 
 #include <iostream>
-#include <list>
+#include <map>
 #include <vector>
 #include <cassert>
-#include <sstream>
+#include <cstring>
 #include <stdexcept>
 #include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+
+// handles of everything RenderInstanceBatch() sets, resolved once per program
+struct BlockProgramHandles {
+    core::UniformHandle camera;
+    core::UniformHandle materialTex;
+    core::UniformHandle materialShininess;
+    core::UniformHandle materialSpecularColor;
+    core::UniformHandle cameraPosition;
+    GLint modelAttrib;
+    GLint layerAttrib;
+
+    BlockProgramHandles() :
+        modelAttrib(-1),
+        layerAttrib(-1)
+    {}
 
+    explicit BlockProgramHandles(const core::Program* shaders) :
+        camera(shaders->uniformHandle("camera")),
+        materialTex(shaders->uniformHandle("materialTex")),
+        materialShininess(shaders->uniformHandle("materialShininess")),
+        materialSpecularColor(shaders->uniformHandle("materialSpecularColor")),
+        cameraPosition(shaders->uniformHandle("cameraPosition")),
+        modelAttrib(shaders->attrib("model")),
+        layerAttrib(shaders->attrib("vertLayer"))
+    {}
+};
 
-struct ModelAsset {
+// a linked program and its handles, shared by every asset that is drawn with it
+struct BlockProgram {
     core::Program* shaders;
-    core::Texture* texture;
+    BlockProgramHandles handles;
+
+    BlockProgram() :
+        shaders(NULL)
+    {}
+};
+
+// vertex data on the GPU, shared by every asset with the same shape
+struct Mesh {
     GLuint vbo;
     GLuint vao;
     GLenum drawType;
     GLint drawStart;
     GLint drawCount;
-    GLfloat shininess;
-    glm::vec3 specularColor;
 
-    ModelAsset() :
-        shaders(NULL),
-        texture(NULL),
+    Mesh() :
         vbo(0),
         vao(0),
         drawType(GL_TRIANGLES),
         drawStart(0),
-        drawCount(0),
+        drawCount(0)
+    {}
+};
+
+// an asset only carries its material, program and mesh come from the shared registry
+struct ModelAsset {
+    BlockProgram* program;
+    Mesh* mesh;
+    GLfloat textureLayer; //layer of `gBlockTextures`
+    GLfloat shininess;
+    glm::vec3 specularColor;
+
+    ModelAsset() :
+        program(NULL),
+        mesh(NULL),
+        textureLayer(0.0f),
         shininess(0.0f),
         specularColor(1.0f, 1.0f, 1.0f)
     {}
@@ -45,15 +121,94 @@ struct ModelAsset {
 
 struct ModelInstance {
     ModelAsset* asset;
-    glm::mat4 transform;
-    glm::vec3 transformInner;
+    core::SceneGraph::Node node; //the world transform is gSceneGraph.worldTransform(node)
 
     ModelInstance() :
         asset(NULL),
-        transform()
+        node(core::SceneGraph::NO_PARENT)
+    {}
+};
+
+// what the vertex shader reads per instance, "model" and "vertLayer"
+struct InstanceData {
+    glm::mat4 transform;
+    GLfloat layer;
+};
+
+// all instances of one asset, drawn with a single instanced draw call
+struct InstanceBatch {
+    ModelAsset* asset;
+    GLuint instanceVbo;
+    std::vector<InstanceData> instances;
+
+    InstanceBatch() :
+        asset(NULL),
+        instanceVbo(0)
+    {}
+};
+
+// the visible faces of one terrain chunk, in world space and grouped by block type
+struct ChunkMesh {
+    BlockProgram* program;
+    GLuint vbo;
+    GLuint vao;
+    std::vector<core::ChunkMesher::Range> ranges;
+    glm::vec3 boundsMin; //world space box around all vertices, for frustum culling
+    glm::vec3 boundsMax;
+    std::vector<core::Rasterizer::Vertex> softwareVertices; //only for the software renderer, which has no `vbo`
+
+    ChunkMesh() :
+        program(NULL),
+        vbo(0),
+        vao(0)
+    {}
+};
+
+// what the frustum culling in Render() kept and dropped during the last frame
+struct CullStats {
+    size_t visibleChunks;
+    size_t culledChunks;
+    size_t visibleBatches;
+    size_t culledBatches;
+
+    CullStats() :
+        visibleChunks(0),
+        culledChunks(0),
+        visibleBatches(0),
+        culledBatches(0)
+    {}
+};
+
+// what Render() sent to the GPU during the last frame
+struct DrawStats {
+    size_t drawCalls;
+    size_t triangles;
+    uint64_t raySteps; // blocks visited by the ray caster
+
+    DrawStats() :
+        drawCalls(0),
+        triangles(0),
+        raySteps(0)
     {}
 };
 
+// what the simulation moves, the rest of the scene is static or follows the input
+struct SimulationState {
+    GLfloat degreesRotated; // how far the car has driven around the middle of the map
+
+    SimulationState() :
+        degreesRotated(0.0f)
+    {}
+};
+
+// the world that CreateScene() built, the scripted camera circles around `center`
+struct SceneInfo {
+    std::string name;
+    glm::vec3 center;
+    float radius;
+    float farPlane;
+};
+
 struct Light {
     glm::vec4 position;
     glm::vec3 transformInner;
@@ -64,7 +219,38 @@ struct Light {
     glm::vec3 coneDirection;
 };
 
+// must match MAX_LIGHTS in fragment-shader.txt
+const size_t MAX_LIGHTS = 32;
+const GLuint LIGHT_BLOCK_BINDING = 0;
+
+// std140 layout of one `Light` inside the `Lights` uniform block of fragment-shader.txt
+struct LightBlockEntry {
+    glm::vec4 position;
+    glm::vec3 intensities;
+    GLfloat attenuation;
+    GLfloat ambientCoefficient;
+    GLfloat coneCosine; //cos(Light::coneAngle)
+    GLfloat padding0[2];
+    glm::vec3 coneDirection;
+    GLfloat padding1;
+};
+
+// std140 layout of the whole `Lights` uniform block
+struct LightBlock {
+    GLint numLights;
+    GLint padding[3];
+    LightBlockEntry allLights[MAX_LIGHTS];
+};
+
+// what the update stage hands to rendering, see WriteFrameState() and --pipeline
+struct FrameState {
+    std::vector<glm::mat4> carTransforms; // the world transforms of `gCarInstances`, in the same order
+    LightBlock lights;
+};
+
 const glm::vec2 SCREEN_SIZE(1920, 1080);
+// edge length of one block in world units, the voxel grid of `gWorld` is BLOCK_SIZE apart
+const int BLOCK_SIZE = 2;
 const enum BlockType { GRAS, BRICKS, GRANITE, STONE_BRICKS, TERRA_COTTA, OAK_LOG, OAK_PLANKS, STONE, COARSE_DIRT, COBBLE_STONE, BLUE_ICE, CLOUD, TIRE, BRAIN };
 
 GLFWwindow* gWindow = NULL;
@@ -72,135 +258,339 @@ double gScrollY = 0.0;
 core::Camera gCamera;
 ModelAsset gExampleModelAsset;
 std::vector<ModelAsset> blocks;
-std::vector<core::Texture*> textures;
-
-std::list<ModelInstance> gInstances;
-std::list<ModelInstance> gCarInstances;
-std::list<ModelInstance> gCarTireInstances;
-GLfloat gDegreesRotated = 0.0f;
+std::map<std::string, BlockProgram*> gPrograms;
+std::map<BlockProgram*, Mesh*> gCubeMeshes;
+BlockProgram* gActiveProgram = NULL;
+core::TextureArray* gBlockTextures = NULL;
+std::vector<GLfloat> textureLayers;
+
+core::VoxelWorld gWorld;
+std::vector<ModelInstance> gCarInstances; // the blocks and the tires
+std::vector<core::SceneGraph::Node> gCarTireNodes; // they spin, the parent of each node places the tire on the car
+core::SceneGraph gSceneGraph;
+core::SceneGraph::Node gCarNode = core::SceneGraph::NO_PARENT; // the parent of all car parts, drives in a circle
+std::vector<ChunkMesh> gChunkMeshes;
+core::ChunkMesher::Mode gTerrainMeshMode = core::ChunkMesher::GREEDY;
+size_t gTerrainTriangles = 0;
+bool gMeshModeKeyDown = false;
+std::vector<const ChunkMesh*> gVisibleChunkMeshes;
+CullStats gCullStats;
+DrawStats gDrawStats;
+size_t gTerrainMeshBytes = 0;
+size_t gTextureBytes = 0;
+SceneInfo gScene;
+std::vector<InstanceBatch> gCarBatches;
+SimulationState gSimulation;
 std::vector<Light> gLights;
 std::vector<Light> gCarLights;
+core::UniformBuffer* gLightBuffer = NULL;
+LightBlock gUploadedLights;
+bool gUploadedLightsValid = false;
+core::Profiler gProfiler;
+core::JobSystem* gJobs = NULL; // for loading and updating, the renderers have thread pools of their own
+std::string gTraceFile; // empty unless tracing was turned on with --trace
+bool gTraceKeyDown = false;
 
 glm::vec3 carPosition = { 2, 2, 2 };
 float carHorizontalAngle = 0;
 
 static core::Program* LoadShaders(const char* vertFilename, const char* fragFilename) {
+    core::Profiler::Scope profile(gProfiler, "LoadShaders", vertFilename);
+
     std::vector<core::Shader> shaders;
     shaders.push_back(core::Shader::shaderFromFile(ResourcePath(vertFilename), GL_VERTEX_SHADER));
     shaders.push_back(core::Shader::shaderFromFile(ResourcePath(fragFilename), GL_FRAGMENT_SHADER));
-    return new core::Program(shaders);
+    core::Program* program = new core::Program(shaders);
+    program->bindUniformBlock("Lights", LIGHT_BLOCK_BINDING);
+    return program;
 }
 
-static core::Texture* LoadTexture(const char* filename) {
+// runs on any thread of `gJobs`, so it only shows up in the trace, not in `gProfiler`
+static core::Bitmap LoadBitmap(const char* filename) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
     core::Bitmap bmp = core::Bitmap::bitmapFromFile(ResourcePath(filename));
     bmp.flipVertically();
-    return new core::Texture(bmp);
+
+    if (core::Trace::enabled())
+        core::Trace::record("LoadBitmap", start, std::chrono::steady_clock::now(), filename);
+    return bmp;
 }
 
-static void LoadExampleAssets() {
+// Make a cube out of triangles (two triangles per side)
+static const GLfloat CUBE_VERTEX_DATA[] = {
+    //  X     Y     Z       U     V          Normal
+    // bottom
+    -1.0f,-1.0f,-1.0f,   0.0f, 0.0f,   0.0f, -1.0f, 0.0f,
+    1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   0.0f, -1.0f, 0.0f,
+    -1.0f,-1.0f, 1.0f,   0.0f, 1.0f,   0.0f, -1.0f, 0.0f,
+    1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   0.0f, -1.0f, 0.0f,
+    1.0f,-1.0f, 1.0f,   1.0f, 1.0f,   0.0f, -1.0f, 0.0f,
+    -1.0f,-1.0f, 1.0f,   0.0f, 1.0f,   0.0f, -1.0f, 0.0f,
+
+    // top
+    -1.0f, 1.0f,-1.0f,   0.0f, 0.0f,   0.0f, 1.0f, 0.0f,
+    -1.0f, 1.0f, 1.0f,   0.0f, 1.0f,   0.0f, 1.0f, 0.0f,
+    1.0f, 1.0f,-1.0f,   1.0f, 0.0f,   0.0f, 1.0f, 0.0f,
+    1.0f, 1.0f,-1.0f,   1.0f, 0.0f,   0.0f, 1.0f, 0.0f,
+    -1.0f, 1.0f, 1.0f,   0.0f, 1.0f,   0.0f, 1.0f, 0.0f,
+    1.0f, 1.0f, 1.0f,   1.0f, 1.0f,   0.0f, 1.0f, 0.0f,
+
+    // front
+    -1.0f,-1.0f, 1.0f,   1.0f, 0.0f,   0.0f, 0.0f, 1.0f,
+    1.0f,-1.0f, 1.0f,   0.0f, 0.0f,   0.0f, 0.0f, 1.0f,
+    -1.0f, 1.0f, 1.0f,   1.0f, 1.0f,   0.0f, 0.0f, 1.0f,
+    1.0f,-1.0f, 1.0f,   0.0f, 0.0f,   0.0f, 0.0f, 1.0f,
+    1.0f, 1.0f, 1.0f,   0.0f, 1.0f,   0.0f, 0.0f, 1.0f,
+    -1.0f, 1.0f, 1.0f,   1.0f, 1.0f,   0.0f, 0.0f, 1.0f,
+
+    // back
+    -1.0f,-1.0f,-1.0f,   0.0f, 0.0f,   0.0f, 0.0f, -1.0f,
+    -1.0f, 1.0f,-1.0f,   0.0f, 1.0f,   0.0f, 0.0f, -1.0f,
+    1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   0.0f, 0.0f, -1.0f,
+    1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   0.0f, 0.0f, -1.0f,
+    -1.0f, 1.0f,-1.0f,   0.0f, 1.0f,   0.0f, 0.0f, -1.0f,
+    1.0f, 1.0f,-1.0f,   1.0f, 1.0f,   0.0f, 0.0f, -1.0f,
+
+    // left
+    -1.0f,-1.0f, 1.0f,   0.0f, 1.0f,   -1.0f, 0.0f, 0.0f,
+    -1.0f, 1.0f,-1.0f,   1.0f, 0.0f,   -1.0f, 0.0f, 0.0f,
+    -1.0f,-1.0f,-1.0f,   0.0f, 0.0f,   -1.0f, 0.0f, 0.0f,
+    -1.0f,-1.0f, 1.0f,   0.0f, 1.0f,   -1.0f, 0.0f, 0.0f,
+    -1.0f, 1.0f, 1.0f,   1.0f, 1.0f,   -1.0f, 0.0f, 0.0f,
+    -1.0f, 1.0f,-1.0f,   1.0f, 0.0f,   -1.0f, 0.0f, 0.0f,
+
+    // right
+    1.0f,-1.0f, 1.0f,   1.0f, 1.0f,   1.0f, 0.0f, 0.0f,
+    1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   1.0f, 0.0f, 0.0f,
+    1.0f, 1.0f,-1.0f,   0.0f, 0.0f,   1.0f, 0.0f, 0.0f,
+    1.0f,-1.0f, 1.0f,   1.0f, 1.0f,   1.0f, 0.0f, 0.0f,
+    1.0f, 1.0f,-1.0f,   0.0f, 0.0f,   1.0f, 0.0f, 0.0f,
+    1.0f, 1.0f, 1.0f,   0.0f, 1.0f,   1.0f, 0.0f, 0.0f
+};
 
-    gExampleModelAsset.shaders = LoadShaders("vertex-shader.txt", "fragment-shader.txt");
-    gExampleModelAsset.drawType = GL_TRIANGLES;
-    gExampleModelAsset.drawStart = 0;
-    gExampleModelAsset.drawCount = 6 * 2 * 3;
-    gExampleModelAsset.texture = LoadTexture("gras.png");
-    gExampleModelAsset.shininess = 80.0;
-    gExampleModelAsset.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
-    glGenBuffers(1, &gExampleModelAsset.vbo);
-    glGenVertexArrays(1, &gExampleModelAsset.vao);
+// returns the program linked from the two shader files, linking it only the first time it is asked for
+static BlockProgram* SharedProgram(const char* vertFilename, const char* fragFilename) {
+    std::string key = std::string(vertFilename) + "|" + fragFilename;
+    std::map<std::string, BlockProgram*>::iterator it = gPrograms.find(key);
+    if (it != gPrograms.end())
+        return it->second;
+
+    BlockProgram* program = new BlockProgram();
+    program->shaders = LoadShaders(vertFilename, fragFilename);
+    program->handles = BlockProgramHandles(program->shaders);
+    gPrograms[key] = program;
+    return program;
+}
+
+// returns the cube mesh wired up to the attributes of `program`, uploading it only the first time
+static Mesh* SharedCubeMesh(BlockProgram* program) {
+    std::map<BlockProgram*, Mesh*>::iterator it = gCubeMeshes.find(program);
+    if (it != gCubeMeshes.end())
+        return it->second;
+
+    Mesh* mesh = new Mesh();
+    mesh->drawType = GL_TRIANGLES;
+    mesh->drawStart = 0;
+    mesh->drawCount = 6 * 2 * 3;
+    glGenBuffers(1, &mesh->vbo);
+    glGenVertexArrays(1, &mesh->vao);
 
     // bind the VAO
-    glBindVertexArray(gExampleModelAsset.vao);
+    glBindVertexArray(mesh->vao);
 
     // bind the VBO
-    glBindBuffer(GL_ARRAY_BUFFER, gExampleModelAsset.vbo);
-
-    // Make a cube out of triangles (two triangles per side)
-    GLfloat vertexData[] = {
-        //  X     Y     Z       U     V          Normal
-        // bottom
-        -1.0f,-1.0f,-1.0f,   0.0f, 0.0f,   0.0f, -1.0f, 0.0f,
-        1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   0.0f, -1.0f, 0.0f,
-        -1.0f,-1.0f, 1.0f,   0.0f, 1.0f,   0.0f, -1.0f, 0.0f,
-        1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   0.0f, -1.0f, 0.0f,
-        1.0f,-1.0f, 1.0f,   1.0f, 1.0f,   0.0f, -1.0f, 0.0f,
-        -1.0f,-1.0f, 1.0f,   0.0f, 1.0f,   0.0f, -1.0f, 0.0f,
-
-        // top
-        -1.0f, 1.0f,-1.0f,   0.0f, 0.0f,   0.0f, 1.0f, 0.0f,
-        -1.0f, 1.0f, 1.0f,   0.0f, 1.0f,   0.0f, 1.0f, 0.0f,
-        1.0f, 1.0f,-1.0f,   1.0f, 0.0f,   0.0f, 1.0f, 0.0f,
-        1.0f, 1.0f,-1.0f,   1.0f, 0.0f,   0.0f, 1.0f, 0.0f,
-        -1.0f, 1.0f, 1.0f,   0.0f, 1.0f,   0.0f, 1.0f, 0.0f,
-        1.0f, 1.0f, 1.0f,   1.0f, 1.0f,   0.0f, 1.0f, 0.0f,
-
-        // front
-        -1.0f,-1.0f, 1.0f,   1.0f, 0.0f,   0.0f, 0.0f, 1.0f,
-        1.0f,-1.0f, 1.0f,   0.0f, 0.0f,   0.0f, 0.0f, 1.0f,
-        -1.0f, 1.0f, 1.0f,   1.0f, 1.0f,   0.0f, 0.0f, 1.0f,
-        1.0f,-1.0f, 1.0f,   0.0f, 0.0f,   0.0f, 0.0f, 1.0f,
-        1.0f, 1.0f, 1.0f,   0.0f, 1.0f,   0.0f, 0.0f, 1.0f,
-        -1.0f, 1.0f, 1.0f,   1.0f, 1.0f,   0.0f, 0.0f, 1.0f,
-
-        // back
-        -1.0f,-1.0f,-1.0f,   0.0f, 0.0f,   0.0f, 0.0f, -1.0f,
-        -1.0f, 1.0f,-1.0f,   0.0f, 1.0f,   0.0f, 0.0f, -1.0f,
-        1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   0.0f, 0.0f, -1.0f,
-        1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   0.0f, 0.0f, -1.0f,
-        -1.0f, 1.0f,-1.0f,   0.0f, 1.0f,   0.0f, 0.0f, -1.0f,
-        1.0f, 1.0f,-1.0f,   1.0f, 1.0f,   0.0f, 0.0f, -1.0f,
-
-        // left
-        -1.0f,-1.0f, 1.0f,   0.0f, 1.0f,   -1.0f, 0.0f, 0.0f,
-        -1.0f, 1.0f,-1.0f,   1.0f, 0.0f,   -1.0f, 0.0f, 0.0f,
-        -1.0f,-1.0f,-1.0f,   0.0f, 0.0f,   -1.0f, 0.0f, 0.0f,
-        -1.0f,-1.0f, 1.0f,   0.0f, 1.0f,   -1.0f, 0.0f, 0.0f,
-        -1.0f, 1.0f, 1.0f,   1.0f, 1.0f,   -1.0f, 0.0f, 0.0f,
-        -1.0f, 1.0f,-1.0f,   1.0f, 0.0f,   -1.0f, 0.0f, 0.0f,
-
-        // right
-        1.0f,-1.0f, 1.0f,   1.0f, 1.0f,   1.0f, 0.0f, 0.0f,
-        1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   1.0f, 0.0f, 0.0f,
-        1.0f, 1.0f,-1.0f,   0.0f, 0.0f,   1.0f, 0.0f, 0.0f,
-        1.0f,-1.0f, 1.0f,   1.0f, 1.0f,   1.0f, 0.0f, 0.0f,
-        1.0f, 1.0f,-1.0f,   0.0f, 0.0f,   1.0f, 0.0f, 0.0f,
-        1.0f, 1.0f, 1.0f,   0.0f, 1.0f,   1.0f, 0.0f, 0.0f
-    };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_VERTEX_DATA), CUBE_VERTEX_DATA, GL_STATIC_DRAW);
 
     // connect the xyz to the "vert" attribute of the vertex shader
-    glEnableVertexAttribArray(gExampleModelAsset.shaders->attrib("vert"));
-    glVertexAttribPointer(gExampleModelAsset.shaders->attrib("vert"), 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), NULL);
+    glEnableVertexAttribArray(program->shaders->attrib("vert"));
+    glVertexAttribPointer(program->shaders->attrib("vert"), 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), NULL);
 
     // connect the uv coords to the "vertTexCoord" attribute of the vertex shader
-    glEnableVertexAttribArray(gExampleModelAsset.shaders->attrib("vertTexCoord"));
-    glVertexAttribPointer(gExampleModelAsset.shaders->attrib("vertTexCoord"), 2, GL_FLOAT, GL_TRUE, 8 * sizeof(GLfloat), (const GLvoid*)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(program->shaders->attrib("vertTexCoord"));
+    glVertexAttribPointer(program->shaders->attrib("vertTexCoord"), 2, GL_FLOAT, GL_TRUE, 8 * sizeof(GLfloat), (const GLvoid*)(3 * sizeof(GLfloat)));
 
     // connect the normal to the "vertNormal" attribute of the vertex shader
-    glEnableVertexAttribArray(gExampleModelAsset.shaders->attrib("vertNormal"));
-    glVertexAttribPointer(gExampleModelAsset.shaders->attrib("vertNormal"), 3, GL_FLOAT, GL_TRUE, 8 * sizeof(GLfloat), (const GLvoid*)(5 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(program->shaders->attrib("vertNormal"));
+    glVertexAttribPointer(program->shaders->attrib("vertNormal"), 3, GL_FLOAT, GL_TRUE, 8 * sizeof(GLfloat), (const GLvoid*)(5 * sizeof(GLfloat)));
 
     // unbind the VAO
     glBindVertexArray(0);
+
+    gCubeMeshes[program] = mesh;
+    return mesh;
+}
+
+static void LoadExampleAssets() {
+
+    gExampleModelAsset.program = SharedProgram("vertex-shader.txt", "fragment-shader.txt");
+    gExampleModelAsset.mesh = SharedCubeMesh(gExampleModelAsset.program);
+    gExampleModelAsset.textureLayer = textureLayers.at(0);
+    gExampleModelAsset.shininess = 80.0;
+    gExampleModelAsset.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
+}
+
+// the block texture files, one per layer, and fills `textureLayers`
+static std::vector<const char*> TextureLayerFiles() {
+    // the order matters, LoadBlockByType() picks its texture by index
+    const char* filenames[] = {
+        "gras.png",
+        "bricks.png",
+        "granite.png",
+        "stone_bricks.png",
+        "terracotta.png",
+        "oak_log.png",
+        "oak_planks.png",
+        "stone.png",
+        "coarse_dirt.png",
+        "cobblestone.png",
+        "blue_ice.png",
+        "water_overlay.png",
+        "terracotta.png",
+        "brain_coral_block.png",
+        "gras.png"
+    };
+
+    // every file becomes one layer of the block texture array, files listed twice share their layer
+    std::map<std::string, GLfloat> layerOfFile;
+    std::vector<const char*> layerFiles;
+    for (size_t i = 0; i < sizeof(filenames) / sizeof(filenames[0]); ++i) {
+        std::map<std::string, GLfloat>::iterator it = layerOfFile.find(filenames[i]);
+        if (it == layerOfFile.end()) {
+            it = layerOfFile.insert(std::make_pair(std::string(filenames[i]), (GLfloat)layerFiles.size())).first;
+            layerFiles.push_back(filenames[i]);
+        }
+        textureLayers.push_back(it->second);
+    }
+    return layerFiles;
+}
+
+// where --bake-textures writes the texture file of the image `filename`, next to the image
+static std::string BakedTexturePath(const char* filename) {
+    std::string path = ResourcePath(filename);
+    return path.substr(0, path.find_last_of('.')) + ".tex";
+}
+
+static bool FileExists(const std::string& path) {
+    return std::ifstream(path.c_str()).good();
+}
+
+// the baked file of the image `filename`, NULL if there is none or the image changed since it was
+// baked, then the image has to be decoded. Says which of the two is used, also from the loading jobs
+static std::unique_ptr<core::TextureFile> OpenBakedTexture(const char* filename) {
+    std::string bakedPath = BakedTexturePath(filename);
+    if (!FileExists(bakedPath))
+        return std::unique_ptr<core::TextureFile>();
+
+    std::unique_ptr<core::TextureFile> file;
+    std::string message;
+    try {
+        file.reset(new core::TextureFile(bakedPath));
+        if (file->isBakedFrom(ResourcePath(filename))) {
+            message = "Loading " + bakedPath + "\n";
+        } else {
+            file.reset();
+            message = std::string(filename) + " changed since it was baked, decoding it instead of " + bakedPath + "\n";
+        }
+    } catch (const std::runtime_error& e) {
+        message = std::string(e.what()) + ", decoding " + filename + " instead\n";
+    }
+
+    // one write per line, so the lines of different jobs don't mix
+    std::cout << message << std::flush;
+    return file;
 }
 
-void LoadTextures() {
-    // ToDo: Push all this texture in the vector textures
-    textures.push_back(LoadTexture("gras.png"));
-    textures.push_back(LoadTexture("bricks.png"));
-    textures.push_back(LoadTexture("granite.png"));
-    textures.push_back(LoadTexture("stone_bricks.png"));
-    textures.push_back(LoadTexture("terracotta.png"));
-    textures.push_back(LoadTexture("oak_log.png"));
-    textures.push_back(LoadTexture("oak_planks.png"));
-    textures.push_back(LoadTexture("stone.png"));
-    textures.push_back(LoadTexture("coarse_dirt.png"));
-    textures.push_back(LoadTexture("cobblestone.png"));
-    textures.push_back(LoadTexture("blue_ice.png"));
-    textures.push_back(LoadTexture("water_overlay.png"));
-    textures.push_back(LoadTexture("terracotta.png"));
-    textures.push_back(LoadTexture("brain_coral_block.png"));
-    textures.push_back(LoadTexture("gras.png"));
+// the bitmap of a block texture, from its baked file if it is up to date, which saves the decoding
+static core::Bitmap LoadTextureLayerBitmap(const char* filename) {
+    std::unique_ptr<core::TextureFile> file = OpenBakedTexture(filename);
+    if (!file)
+        return LoadBitmap(filename);
+
+    return core::Bitmap(file->width(), file->height(), file->format(), file->level(0).pixels);
+}
+
+// one layer of the block textures on its way into `gBlockTextures`
+struct PendingTextureLayer {
+    std::unique_ptr<core::TextureFile> baked; // mapped by StartLoadingTextures() if the layer was baked from the current image
+    size_t bitmap;                            // otherwise the image decoded by the BitmapLoader
+};
+
+// maps the baked block textures and starts decoding the others in `loader`, fills `textureLayers`
+static void StartLoadingTextures(core::BitmapLoader& loader, std::vector<PendingTextureLayer>& layers) {
+    std::vector<const char*> layerFiles = TextureLayerFiles();
+    layers.clear();
+    layers.resize(layerFiles.size());
+    for (size_t i = 0; i < layerFiles.size(); ++i) {
+        layers[i].baked = OpenBakedTexture(layerFiles[i]);
+        if (!layers[i].baked) {
+            const char* filename = layerFiles[i];
+            layers[i].bitmap = loader.load([filename]() { return LoadBitmap(filename); });
+        }
+    }
+}
+
+// 4 bytes per texel and a third more for the mipmaps
+static size_t TextureLayerBytes(unsigned width, unsigned height) {
+    return (size_t)width * height * 4 * 4 / 3;
+}
+
+// loads the block textures into `layers` and fills `textureLayers`, needs no GL
+static void LoadTextureLayers(std::vector<core::Bitmap>& layers) {
+    core::Profiler::Scope profile(gProfiler, "LoadTextureLayers");
+
+    core::BitmapLoader loader(*gJobs);
+    std::vector<const char*> layerFiles = TextureLayerFiles();
+    for (size_t i = 0; i < layerFiles.size(); ++i) {
+        const char* filename = layerFiles[i];
+        loader.load([filename]() { return LoadTextureLayerBitmap(filename); });
+    }
+    layers.clear();
+    gTextureBytes = 0;
+    for (size_t i = 0; i < loader.count(); ++i) {
+        layers.push_back(loader.take(i));
+        gTextureBytes += TextureLayerBytes(layers.back().width(), layers.back().height());
+    }
+}
+
+// uploads the block textures that StartLoadingTextures() started, each layer as soon as it is ready
+void LoadTextures(core::BitmapLoader& loader, std::vector<PendingTextureLayer>& layers) {
+    core::Profiler::Scope profile(gProfiler, "LoadTextures");
+
+    // repeat, so greedy meshed quads can tile the texture once per block
+    // trilinear + anisotropic, so the far ground samples small mip levels instead of the full 512x512 images
+    gBlockTextures = new core::TextureArray((GLsizei)layers.size(), GL_LINEAR_MIPMAP_LINEAR, GL_REPEAT, 8.0f);
+    gTextureBytes = 0;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        // the baked files are unmapped right after the upload, so their pages can go again
+        if (layers[i].baked) {
+            gBlockTextures->setLayer((GLsizei)i, *layers[i].baked);
+            gTextureBytes += TextureLayerBytes(layers[i].baked->width(), layers[i].baked->height());
+            layers[i].baked.reset();
+            continue;
+        }
+
+        core::Bitmap layer = loader.take(layers[i].bitmap);
+        gBlockTextures->setLayer((GLsizei)i, layer);
+        gTextureBytes += TextureLayerBytes(layer.width(), layer.height());
+    }
+}
+
+// writes the texture file of every block texture, see TextureFile, later runs upload them without decoding
+static void BakeTextures() {
+    core::BitmapLoader loader(*gJobs);
+    std::vector<const char*> layerFiles = TextureLayerFiles();
+    for (size_t i = 0; i < layerFiles.size(); ++i) {
+        const char* filename = layerFiles[i];
+        loader.load([filename]() { return LoadBitmap(filename); });
+    }
+
+    for (size_t i = 0; i < layerFiles.size(); ++i) {
+        std::string bakedPath = BakedTexturePath(layerFiles[i]);
+        core::TextureFile::write(bakedPath, loader.take(i), true, ResourcePath(layerFiles[i]));
+        std::cout << "Baked " << layerFiles[i] << " into " << bakedPath << std::endl;
+    }
 }
 
 // initialises the gOtherCrate global
@@ -208,139 +598,56 @@ void LoadBlockByType(BlockType type) {
 
     ModelAsset gLocalAsset;
 
-    // set all the elements of gOtherCrate
-    gLocalAsset.shaders = LoadShaders("vertex-shader.txt", "fragment-shader.txt");
-    gLocalAsset.drawType = GL_TRIANGLES;
-    gLocalAsset.drawStart = 0;
-    gLocalAsset.drawCount = 6 * 2 * 3;
-
-    // ToDo: Use here the vector textures !! Performance !!!
 
     // GRAS, BRICKS, GRANITE, STONE_BRICKS, TERRA_COTTA, OAK_LOG, OAK_PLANKS, STONE, COARSE_DIRT, COBBLE_STONE, BLUE_ICE, CLOUD, TIRE, BRAIN
     if (type == GRAS) {
-        gLocalAsset.texture = textures.at(0);
+        gLocalAsset.textureLayer = textureLayers.at(0);
     }
     else if (type == BRICKS) {
-        gLocalAsset.texture = textures.at(1);
+        gLocalAsset.textureLayer = textureLayers.at(1);
     }
     else if (type == GRANITE) {
-        gLocalAsset.texture = textures.at(2);
+        gLocalAsset.textureLayer = textureLayers.at(2);
     }
     else if (type == STONE_BRICKS) {
-        gLocalAsset.texture = textures.at(3);
+        gLocalAsset.textureLayer = textureLayers.at(3);
     }
     else if (type == TERRA_COTTA) {
-        gLocalAsset.texture = textures.at(4);
+        gLocalAsset.textureLayer = textureLayers.at(4);
     }
     else if (type == OAK_LOG) {
-        gLocalAsset.texture = textures.at(5);
+        gLocalAsset.textureLayer = textureLayers.at(5);
     }
     else if (type == OAK_PLANKS) {
-        gLocalAsset.texture = textures.at(6);
+        gLocalAsset.textureLayer = textureLayers.at(6);
     }
     else if (type == STONE) {
-        gLocalAsset.texture = textures.at(7);
+        gLocalAsset.textureLayer = textureLayers.at(7);
     }
     else if (type == COARSE_DIRT) {
-        gLocalAsset.texture = textures.at(8);
+        gLocalAsset.textureLayer = textureLayers.at(8);
     }
     else if (type == COBBLE_STONE) {
-        gLocalAsset.texture = textures.at(9);
+        gLocalAsset.textureLayer = textureLayers.at(9);
     }
     else if (type == BLUE_ICE) {
-        gLocalAsset.texture = textures.at(10);
+        gLocalAsset.textureLayer = textureLayers.at(10);
     }
     else if (type == CLOUD) {
-        gLocalAsset.texture = textures.at(11);
+        gLocalAsset.textureLayer = textureLayers.at(11);
     }
     else if (type == TIRE) {
-        gLocalAsset.texture = textures.at(12);
+        gLocalAsset.textureLayer = textureLayers.at(12);
     }
     else if (type == BRAIN) {
-        gLocalAsset.texture = textures.at(13);
+        gLocalAsset.textureLayer = textureLayers.at(13);
     }
     else {
-        gLocalAsset.texture = textures.at(0);
+        gLocalAsset.textureLayer = textureLayers.at(0);
     }
     
     gLocalAsset.shininess = 50.0;
     gLocalAsset.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
-    glGenBuffers(1, &gLocalAsset.vbo);
-    glGenVertexArrays(1, &gLocalAsset.vao);
-
-    // bind the VAO
-    glBindVertexArray(gLocalAsset.vao);
-
-    // bind the VBO
-    glBindBuffer(GL_ARRAY_BUFFER, gLocalAsset.vbo);
-
-    // Make a cube out of triangles (two triangles per side)
-    GLfloat vertexData[] = {
-        //  X     Y     Z       U     V          Normal
-        // bottom
-        -1.0f,-1.0f,-1.0f,   0.0f, 0.0f,   0.0f, -1.0f, 0.0f,
-        1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   0.0f, -1.0f, 0.0f,
-        -1.0f,-1.0f, 1.0f,   0.0f, 1.0f,   0.0f, -1.0f, 0.0f,
-        1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   0.0f, -1.0f, 0.0f,
-        1.0f,-1.0f, 1.0f,   1.0f, 1.0f,   0.0f, -1.0f, 0.0f,
-        -1.0f,-1.0f, 1.0f,   0.0f, 1.0f,   0.0f, -1.0f, 0.0f,
-
-        // top
-        -1.0f, 1.0f,-1.0f,   0.0f, 0.0f,   0.0f, 1.0f, 0.0f,
-        -1.0f, 1.0f, 1.0f,   0.0f, 1.0f,   0.0f, 1.0f, 0.0f,
-        1.0f, 1.0f,-1.0f,   1.0f, 0.0f,   0.0f, 1.0f, 0.0f,
-        1.0f, 1.0f,-1.0f,   1.0f, 0.0f,   0.0f, 1.0f, 0.0f,
-        -1.0f, 1.0f, 1.0f,   0.0f, 1.0f,   0.0f, 1.0f, 0.0f,
-        1.0f, 1.0f, 1.0f,   1.0f, 1.0f,   0.0f, 1.0f, 0.0f,
-
-        // front
-        -1.0f,-1.0f, 1.0f,   1.0f, 0.0f,   0.0f, 0.0f, 1.0f,
-        1.0f,-1.0f, 1.0f,   0.0f, 0.0f,   0.0f, 0.0f, 1.0f,
-        -1.0f, 1.0f, 1.0f,   1.0f, 1.0f,   0.0f, 0.0f, 1.0f,
-        1.0f,-1.0f, 1.0f,   0.0f, 0.0f,   0.0f, 0.0f, 1.0f,
-        1.0f, 1.0f, 1.0f,   0.0f, 1.0f,   0.0f, 0.0f, 1.0f,
-        -1.0f, 1.0f, 1.0f,   1.0f, 1.0f,   0.0f, 0.0f, 1.0f,
-
-        // back
-        -1.0f,-1.0f,-1.0f,   0.0f, 0.0f,   0.0f, 0.0f, -1.0f,
-        -1.0f, 1.0f,-1.0f,   0.0f, 1.0f,   0.0f, 0.0f, -1.0f,
-        1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   0.0f, 0.0f, -1.0f,
-        1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   0.0f, 0.0f, -1.0f,
-        -1.0f, 1.0f,-1.0f,   0.0f, 1.0f,   0.0f, 0.0f, -1.0f,
-        1.0f, 1.0f,-1.0f,   1.0f, 1.0f,   0.0f, 0.0f, -1.0f,
-
-        // left
-        -1.0f,-1.0f, 1.0f,   0.0f, 1.0f,   -1.0f, 0.0f, 0.0f,
-        -1.0f, 1.0f,-1.0f,   1.0f, 0.0f,   -1.0f, 0.0f, 0.0f,
-        -1.0f,-1.0f,-1.0f,   0.0f, 0.0f,   -1.0f, 0.0f, 0.0f,
-        -1.0f,-1.0f, 1.0f,   0.0f, 1.0f,   -1.0f, 0.0f, 0.0f,
-        -1.0f, 1.0f, 1.0f,   1.0f, 1.0f,   -1.0f, 0.0f, 0.0f,
-        -1.0f, 1.0f,-1.0f,   1.0f, 0.0f,   -1.0f, 0.0f, 0.0f,
-
-        // right
-        1.0f,-1.0f, 1.0f,   1.0f, 1.0f,   1.0f, 0.0f, 0.0f,
-        1.0f,-1.0f,-1.0f,   1.0f, 0.0f,   1.0f, 0.0f, 0.0f,
-        1.0f, 1.0f,-1.0f,   0.0f, 0.0f,   1.0f, 0.0f, 0.0f,
-        1.0f,-1.0f, 1.0f,   1.0f, 1.0f,   1.0f, 0.0f, 0.0f,
-        1.0f, 1.0f,-1.0f,   0.0f, 0.0f,   1.0f, 0.0f, 0.0f,
-        1.0f, 1.0f, 1.0f,   0.0f, 1.0f,   1.0f, 0.0f, 0.0f
-    };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
-
-    // connect the xyz to the "vert" attribute of the vertex shader
-    glEnableVertexAttribArray(gLocalAsset.shaders->attrib("vert"));
-    glVertexAttribPointer(gLocalAsset.shaders->attrib("vert"), 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), NULL);
-
-    // connect the uv coords to the "vertTexCoord" attribute of the vertex shader
-    glEnableVertexAttribArray(gLocalAsset.shaders->attrib("vertTexCoord"));
-    glVertexAttribPointer(gLocalAsset.shaders->attrib("vertTexCoord"), 2, GL_FLOAT, GL_TRUE, 8 * sizeof(GLfloat), (const GLvoid*)(3 * sizeof(GLfloat)));
-
-    // connect the normal to the "vertNormal" attribute of the vertex shader
-    glEnableVertexAttribArray(gLocalAsset.shaders->attrib("vertNormal"));
-    glVertexAttribPointer(gLocalAsset.shaders->attrib("vertNormal"), 3, GL_FLOAT, GL_TRUE, 8 * sizeof(GLfloat), (const GLvoid*)(5 * sizeof(GLfloat)));
-
-    // unbind the VAO
-    glBindVertexArray(0);
 
     blocks.push_back(gLocalAsset);
 }
@@ -364,6 +671,23 @@ void LoadAllBlockTypes() {
     LoadBlockByType(BRAIN);         // 13
 }
 
+// all block types share one program and one cube, only the material differs
+static void LoadBlockMeshes() {
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        blocks[i].program = SharedProgram("vertex-shader.txt", "fragment-shader.txt");
+        blocks[i].mesh = SharedCubeMesh(blocks[i].program);
+    }
+}
+
+// voxel ids are the index into `blocks` plus one, because 0 is kept for empty space
+static core::VoxelWorld::BlockId BlockIdForIndex(int blockIndex) {
+    return (core::VoxelWorld::BlockId)(blockIndex + 1);
+}
+
+static ModelAsset* AssetForBlockId(core::VoxelWorld::BlockId id) {
+    return &blocks.at(id - 1);
+}
+
 // convenience function that returns a translation matrix
 glm::mat4 translate(GLfloat x, GLfloat y, GLfloat z) {
     return glm::translate(glm::mat4(), glm::vec3(x, y, z));
@@ -374,77 +698,84 @@ glm::mat4 scale(GLfloat x, GLfloat y, GLfloat z) {
     return glm::scale(glm::mat4(), glm::vec3(x, y, z));
 }
 
-//create all the `instance` structs for the 3D scene, and add them to `gInstances`
+// where the car is after turning `degreesRotated` around the middle of the map
+static void PlaceCar(GLfloat degreesRotated) {
+    glm::quat rotation = glm::angleAxis(glm::radians(degreesRotated), glm::vec3(0, 1, 0));
+    glm::vec3 position = glm::vec3(30.0f, 2.0f, 30.0f) + rotation * glm::vec3(25.0f, 0.0f, 0.0f);
+    gSceneGraph.setLocalTransform(gCarNode, position, rotation);
+}
+
+// how far a tire has turned after the car turned `degreesRotated`
+static glm::quat TireSpin(GLfloat degreesRotated) {
+    return glm::angleAxis(glm::radians(-degreesRotated * 8), glm::vec3(1, 0, 0));
+}
+
+// a block of the car, `offset` is its place on the car
+static void AddCarBlock(int blockIndex, const glm::vec3& offset) {
+    ModelInstance block;
+    block.asset = &blocks.at(blockIndex);
+    block.node = gSceneGraph.addNode(gCarNode, offset, glm::quat());
+    gCarInstances.push_back(block);
+}
+
+// a tire at `offset` on the car, it spins around its own axle
+static void AddCarTire(const glm::vec3& offset) {
+    ModelInstance tire;
+    tire.asset = &blocks.at(TIRE);
+    core::SceneGraph::Node axle = gSceneGraph.addNode(gCarNode, offset, glm::quat());
+    tire.node = gSceneGraph.addNode(axle, glm::vec3(0.0f), TireSpin(gSimulation.degreesRotated));
+    gCarInstances.push_back(tire);
+    gCarTireNodes.push_back(tire.node);
+}
+
+// builds the car in `gSceneGraph`, all its parts are children of `gCarNode`
 static void CreateCar() {
 
     GLfloat offset = 2.0f;
     GLfloat baseHeight = 1.0f;
 
+    gCarNode = gSceneGraph.addNode(core::SceneGraph::NO_PARENT, glm::vec3(0.0f), glm::quat());
+    PlaceCar(gSimulation.degreesRotated);
 
     for (int transX = 0; transX < 2; transX++) {
         for (int transY = 0; transY < 4; transY++) {
-            ModelInstance ass1;
-            ass1.asset = &blocks.at(13);
-            ass1.transform = glm::mat4() * glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, 0.0f));
-            ass1.transformInner = glm::vec3(transX * offset, baseHeight, transY * offset);
-            gCarInstances.push_back(ass1);
+            AddCarBlock(BRAIN, glm::vec3(transX * offset, baseHeight, transY * offset));
         }
     }
 
     baseHeight = 3.0f;
     for (int transX = 0; transX < 2; transX++) {
         for (int transY = 0; transY < 2; transY++) {
-            ModelInstance ass1;
-            ass1.asset = &blocks.at(13);
-            ass1.transform = glm::mat4() * glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, 0.0f));
-            ass1.transformInner = glm::vec3(transX * offset, baseHeight, transY * offset);
-            gCarInstances.push_back(ass1);
+            AddCarBlock(BRAIN, glm::vec3(transX * offset, baseHeight, transY * offset));
         }
     }
 
     baseHeight = 3.0f;
     for (int transX = 0; transX < 2; transX++) {
         for (int transY = 2; transY < 3; transY++) {
-            ModelInstance ass1;
-            ass1.asset = &blocks.at(11);
-            ass1.transform = glm::mat4() * glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, 0.0f));
-            ass1.transformInner = glm::vec3(transX * offset, baseHeight, transY * offset);
-            gCarInstances.push_back(ass1);
+            AddCarBlock(CLOUD, glm::vec3(transX * offset, baseHeight, transY * offset));
         }
     }
 
-    ModelInstance tire1;
-    tire1.asset = &blocks.at(12);
-    tire1.transform = glm::mat4() * glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, 0.0f));
-    tire1.transformInner = glm::vec3(1.5f * offset, 0.0f, 3.0f * offset);
-    gCarTireInstances.push_back(tire1);
-
-    ModelInstance tire2;
-    tire2.asset = &blocks.at(12);
-    tire2.transform = glm::mat4() * glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, 0.0f));
-    tire2.transformInner = glm::vec3(-0.5f * offset, 0.0f, 3.0f * offset);
-    gCarTireInstances.push_back(tire2);
-
-    ModelInstance tire3;
-    tire3.asset = &blocks.at(12);
-    tire3.transform = glm::mat4() * glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, 0.0f));
-    tire3.transformInner = glm::vec3(1.5f * offset, 0.0f, -0.0f * offset);
-    gCarTireInstances.push_back(tire3);
+    AddCarTire(glm::vec3(1.5f * offset, 0.0f, 3.0f * offset));
+    AddCarTire(glm::vec3(-0.5f * offset, 0.0f, 3.0f * offset));
+    AddCarTire(glm::vec3(1.5f * offset, 0.0f, -0.0f * offset));
+    AddCarTire(glm::vec3(-0.5f * offset, 0.0f, -0.0f * offset));
+}
 
-    ModelInstance tire4;
-    tire4.asset = &blocks.at(12);
-    tire4.transform = glm::mat4() * glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, 0.0f));
-    tire4.transformInner = glm::vec3(-0.5f * offset, 0.0f, -0.0f * offset);
-    gCarTireInstances.push_back(tire4);
+// puts the block with index `blockIndex` into `blocks` at the grid position x, y, z
+static void PlaceBlock(int x, int y, int z, int blockIndex) {
+    gWorld.set(x, y, z, BlockIdForIndex(blockIndex));
 }
 
+// fills `gWorld`, all positions are in blocks, see BLOCK_SIZE
 static void CreateTerrain() {
+    core::Profiler::Scope profile(gProfiler, "CreateTerrain");
 
     // A block got a height and width of 2 !
     const int size = 30;
-    const int offset = 2;
-    float base_height = 0;
-    float hori_offset = -size / 2;
+    const int base_height = 0;
+    const int inner_origin = 20 / BLOCK_SIZE;
 
     // Base ground
 
@@ -605,10 +936,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 4; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_0[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(9);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 9);
                 }
             }
         }
@@ -621,10 +949,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 3; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_1[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(9);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 9);
                 }
             }
         }
@@ -637,10 +962,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 2; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_2[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(4);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 4);
                 }
             }
         }
@@ -653,10 +975,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 2; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_3[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(4);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 4);
                 }
             }
         }
@@ -669,10 +988,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 2; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_4[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(8);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 8);
                 }
             }
         }
@@ -685,10 +1001,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 2; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_3[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(8);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 8);
                 }
             }
         }
@@ -701,10 +1014,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 2; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_4[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(8);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 8);
                 }
             }
         }
@@ -717,10 +1027,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 2; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_3[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(0);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 0);
                 }
             }
         }
@@ -733,10 +1040,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 2; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_4[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(0);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 0);
                 }
             }
         }
@@ -749,10 +1053,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 2; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_3[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(0);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 0);
                 }
             }
         }
@@ -765,10 +1066,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 2; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_2[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(10);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 10);
                 }
             }
         }
@@ -781,10 +1079,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 3; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_1[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(10);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 10);
                 }
             }
         }
@@ -797,10 +1092,7 @@ static void CreateTerrain() {
             for (int transZ = 0; transZ < 4; transZ++) {
                 // creedy impl... now if bigger null custom texture...
                 if (maze_inner_0[transX][transY] > 0) {  // negative, so no cube
-                    ModelInstance block;
-                    block.asset = &blocks.at(10);
-                    block.transform = translate(20 + transX * offset, transZ * offset + (start_height * offset), 20 + transY * offset) * scale(1, 1, 1);
-                    gInstances.push_back(block);
+                    PlaceBlock(inner_origin + transX, start_height + transZ, inner_origin + transY, 10);
                 }
             }
         }
@@ -810,22 +1102,137 @@ static void CreateTerrain() {
     for (int transX = 0; transX < size; transX++) {
         for (int transY = 0; transY < size; transY++) {
             if (maze[transX][transY] >= 0) {  // negative, so no cube
-                ModelInstance block;
-                block.asset = &blocks.at(maze[transX][transY]);
-                block.transform = translate(transX * offset, base_height, transY * offset) * scale(1, 1, 1);
-                gInstances.push_back(block);
+                PlaceBlock(transX, base_height, transY, maze[transX][transY]);
             }
         }
     }
 }
 
-template <typename T>
-void SetLightUniform(core::Program* shaders, const char* propertyName, size_t lightIndex, const T& value) {
-    std::ostringstream ss;
-    ss << "allLights[" << lightIndex << "]." << propertyName;
-    std::string uniformName = ss.str();
+// a flat 256 x 256 meadow crossed by stone paths, with a few tree trunks, to measure large mostly flat scenes
+static void CreateGround256() {
+    core::Profiler::Scope profile(gProfiler, "CreateGround256");
+
+    const int size = 256;
+    for (int x = 0; x < size; ++x) {
+        for (int z = 0; z < size; ++z) {
+            bool path = (x % 32 == 16) || (z % 32 == 16);
+            PlaceBlock(x, 0, z, path ? STONE_BRICKS : GRAS);
+
+            // a fixed pattern instead of random numbers, so every run builds the same world
+            if (!path && (x * 7 + z * 13) % 97 == 0) {
+                for (int y = 1; y <= 4; ++y)
+                    PlaceBlock(x, y, z, OAK_LOG);
+            }
+        }
+    }
+}
+
+// 0 to 1, the same for the same input on every platform
+static float HashNoise(int x, int z) {
+    unsigned h = (unsigned)x * 374761393u + (unsigned)z * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    h ^= h >> 16;
+    return (float)(h & 0xffffu) / 65535.0f;
+}
 
-    shaders->setUniform(uniformName.c_str(), value);
+// smoothly interpolated HashNoise on a grid with `cellSize` blocks per cell
+static float ValueNoise(int x, int z, int cellSize) {
+    int cellX = x / cellSize;
+    int cellZ = z / cellSize;
+    float fx = (float)(x % cellSize) / (float)cellSize;
+    float fz = (float)(z % cellSize) / (float)cellSize;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fz = fz * fz * (3.0f - 2.0f * fz);
+    float top = glm::mix(HashNoise(cellX, cellZ), HashNoise(cellX + 1, cellZ), fx);
+    float bottom = glm::mix(HashNoise(cellX, cellZ + 1), HashNoise(cellX + 1, cellZ + 1), fx);
+    return glm::mix(top, bottom, fz);
+}
+
+// 1024 x 1024 blocks of rolling hills, to see how everything scales with the size of the world
+static void CreateWorld1024() {
+    core::Profiler::Scope profile(gProfiler, "CreateWorld1024");
+
+    const int size = 1024;
+    const int depth = 3; // only the top blocks of every column, the hills are too flat to look below them
+
+    // the noise is computed in parallel, the world itself can only be filled by one thread
+    std::vector<int> heights(size * size);
+    gJobs->parallelFor(size, 16, [&](size_t begin, size_t end) {
+        for (int x = (int)begin; x < (int)end; ++x) {
+            for (int z = 0; z < size; ++z)
+                heights[x * size + z] = 2 + (int)(14.0f * ValueNoise(x, z, 64) + 4.0f * ValueNoise(x, z, 16));
+        }
+    });
+
+    for (int x = 0; x < size; ++x) {
+        for (int z = 0; z < size; ++z) {
+            int height = heights[x * size + z];
+            for (int y = std::max(0, height - depth); y <= height; ++y) {
+                int blockIndex = (y == height) ? (height > 14 ? STONE : GRAS) : COARSE_DIRT;
+                PlaceBlock(x, y, z, blockIndex);
+            }
+        }
+    }
+}
+
+// fills `gWorld` with the scene called `name` and sets `gScene`
+static void CreateScene(const std::string& name) {
+    gScene.name = name;
+    if (name == "maze") {
+        CreateTerrain();
+        gScene.center = glm::vec3(29.0f, 0.0f, 29.0f);
+        gScene.radius = 48.0f;
+        gScene.farPlane = 100.0f;
+    }
+    else if (name == "ground256") {
+        CreateGround256();
+        gScene.center = glm::vec3(256.0f, 0.0f, 256.0f);
+        gScene.radius = 300.0f;
+        gScene.farPlane = 800.0f;
+    }
+    else if (name == "world1024") {
+        CreateWorld1024();
+        gScene.center = glm::vec3(1024.0f, 0.0f, 1024.0f);
+        gScene.radius = 700.0f;
+        // the far corner of the world seen from the scripted orbit, which rises up to half its radius
+        float halfDiagonal = glm::length(glm::vec2(gScene.center.x, gScene.center.z));
+        gScene.farPlane = glm::length(glm::vec2(gScene.radius + halfDiagonal, 0.5f * gScene.radius));
+    }
+    else {
+        throw std::runtime_error("Unknown scene " + name + ", use maze, ground256 or world1024");
+    }
+}
+
+// packs `gLights` into the std140 light block
+static LightBlock PackLights() {
+    if (gLights.size() > MAX_LIGHTS)
+        throw std::runtime_error("Too many lights, raise MAX_LIGHTS");
+
+    LightBlock block = LightBlock();
+    block.numLights = (GLint)gLights.size();
+    for (size_t i = 0; i < gLights.size(); ++i) {
+        block.allLights[i].position = gLights[i].position;
+        block.allLights[i].intensities = gLights[i].intensities;
+        block.allLights[i].attenuation = gLights[i].attenuation;
+        block.allLights[i].ambientCoefficient = gLights[i].ambientCoefficient;
+        // the shader compares cosines, so it needs neither acos() nor a normalize per pixel
+        block.allLights[i].coneCosine = std::cos(glm::radians(gLights[i].coneAngle));
+        if (glm::length(gLights[i].coneDirection) > 0.0f)
+            block.allLights[i].coneDirection = glm::normalize(gLights[i].coneDirection);
+    }
+    return block;
+}
+
+// uploads the packed lights, but only if anything changed since the last upload
+static void UpdateLightBuffer(const LightBlock& block) {
+    core::Profiler::Scope profile(gProfiler, "UpdateLightBuffer");
+
+    if (gUploadedLightsValid && memcmp(&block, &gUploadedLights, sizeof(block)) == 0)
+        return;
+
+    gLightBuffer->update(&block, sizeof(block));
+    gUploadedLights = block;
+    gUploadedLightsValid = true;
 }
 
 // Setup all lights
@@ -875,116 +1282,429 @@ void CreateAllLights() {
     gLights.push_back(directionalLight);
 }
 
-//renders a single `ModelInstance`
-static void RenderInstance(const ModelInstance& inst) {
-    ModelAsset* asset = inst.asset;
-    core::Program* shaders = asset->shaders;
+// returns the batch of `asset`, creating it (and its VBO) if there is none yet
+static InstanceBatch& BatchForAsset(std::vector<InstanceBatch>& batches, ModelAsset* asset) {
+    for (size_t i = 0; i < batches.size(); ++i) {
+        if (batches[i].asset == asset)
+            return batches[i];
+    }
 
-    //bind the shaders
+    InstanceBatch batch;
+    batch.asset = asset;
+    glGenBuffers(1, &batch.instanceVbo);
+    batches.push_back(batch);
+    return batches.back();
+}
+
+// sorts the instances into one batch per asset, reusing the batches (and their VBOs) that already exist
+static void BuildInstanceBatches(const std::vector<ModelInstance>& instances, const std::vector<glm::mat4>& transforms, std::vector<InstanceBatch>& batches) {
+    for (size_t i = 0; i < batches.size(); ++i)
+        batches[i].instances.clear();
+
+    for (size_t i = 0; i < instances.size(); ++i) {
+        InstanceData instance;
+        instance.transform = transforms[i];
+        instance.layer = instances[i].asset->textureLayer;
+        BatchForAsset(batches, instances[i].asset).instances.push_back(instance);
+    }
+}
+
+// releases the buffers of all chunk meshes and empties `meshes`
+static void DeleteChunkMeshes(std::vector<ChunkMesh>& meshes) {
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        glDeleteVertexArrays(1, &meshes[i].vao);
+        glDeleteBuffers(1, &meshes[i].vbo);
+    }
+    meshes.clear();
+}
+
+// meshes every chunk of `world` into `meshes`, keeping only the faces that can be seen
+// `gpu` uploads the meshes into buffers for Render(), otherwise they stay on the CPU for the software renderer
+static void BuildChunkMeshes(const core::VoxelWorld& world, core::ChunkMesher::Mode mode, std::vector<ChunkMesh>& meshes, bool gpu) {
+    core::ChunkMesher mesher(world, (GLfloat)BLOCK_SIZE);
+    mesher.setMode(mode);
+    for (size_t i = 0; i < blocks.size(); ++i)
+        mesher.setBlock(BlockIdForIndex((int)i), blocks[i].textureLayer, i == CLOUD);
+
+    BlockProgram* program = gpu ? SharedProgram("vertex-shader.txt", "fragment-shader.txt") : NULL;
+    size_t quadCount = 0;
+    size_t culledCount = 0;
+    size_t meshBytes = 0;
+
+    // the chunks are meshed in parallel, the buffers can only be created on the GL thread afterwards
+    const std::vector<core::VoxelWorld::Chunk*>& chunks = world.chunks();
+    std::vector<std::vector<core::ChunkMesher::Vertex> > chunkVertices(chunks.size());
+    std::vector<std::vector<core::ChunkMesher::Range> > chunkRanges(chunks.size());
+    std::vector<size_t> chunkCulled(chunks.size());
+    gJobs->parallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c)
+            chunkCulled[c] = mesher.build(*chunks[c], chunkVertices[c], chunkRanges[c]);
+    });
+
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        ChunkMesh mesh;
+        std::vector<core::ChunkMesher::Vertex> vertices;
+        vertices.swap(chunkVertices[c]);
+        mesh.ranges.swap(chunkRanges[c]);
+        culledCount += chunkCulled[c];
+        quadCount += vertices.size() / 6;
+        if (vertices.empty())
+            continue;
+
+        mesh.program = program;
+        mesh.boundsMin = mesh.boundsMax = vertices[0].position;
+        for (size_t v = 1; v < vertices.size(); ++v) {
+            mesh.boundsMin = glm::min(mesh.boundsMin, vertices[v].position);
+            mesh.boundsMax = glm::max(mesh.boundsMax, vertices[v].position);
+        }
+        meshBytes += vertices.size() * sizeof(core::ChunkMesher::Vertex);
+
+        if (!gpu) {
+            // the layer is the same for a whole range, the rasterizer takes it from the material instead
+            mesh.softwareVertices.resize(vertices.size());
+            for (size_t v = 0; v < vertices.size(); ++v) {
+                mesh.softwareVertices[v].position = vertices[v].position;
+                mesh.softwareVertices[v].texCoord = vertices[v].texCoord;
+                mesh.softwareVertices[v].normal = vertices[v].normal;
+            }
+            meshes.push_back(mesh);
+            continue;
+        }
+
+        glGenBuffers(1, &mesh.vbo);
+        glGenVertexArrays(1, &mesh.vao);
+        glBindVertexArray(mesh.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(core::ChunkMesher::Vertex), &vertices[0], GL_STATIC_DRAW);
+
+        // same attributes as the cube mesh, "model" stays a constant identity because the vertices are already in world space
+        const GLsizei stride = sizeof(core::ChunkMesher::Vertex);
+        glEnableVertexAttribArray(program->shaders->attrib("vert"));
+        glVertexAttribPointer(program->shaders->attrib("vert"), 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof(core::ChunkMesher::Vertex, position));
+        glEnableVertexAttribArray(program->shaders->attrib("vertTexCoord"));
+        glVertexAttribPointer(program->shaders->attrib("vertTexCoord"), 2, GL_FLOAT, GL_TRUE, stride, (const GLvoid*)offsetof(core::ChunkMesher::Vertex, texCoord));
+        glEnableVertexAttribArray(program->shaders->attrib("vertNormal"));
+        glVertexAttribPointer(program->shaders->attrib("vertNormal"), 3, GL_FLOAT, GL_TRUE, stride, (const GLvoid*)offsetof(core::ChunkMesher::Vertex, normal));
+        glEnableVertexAttribArray(program->handles.layerAttrib);
+        glVertexAttribPointer(program->handles.layerAttrib, 1, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof(core::ChunkMesher::Vertex, layer));
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        meshes.push_back(mesh);
+    }
+
+    gTerrainTriangles = quadCount * 2;
+    gTerrainMeshBytes = meshBytes;
+    std::cout << "Terrain mesh (" << (mode == core::ChunkMesher::GREEDY ? "greedy" : "naive") << "): "
+              << quadCount << " quads, " << gTerrainTriangles << " triangles, "
+              << culledCount << " hidden faces culled" << std::endl;
+}
+
+// copies the instances of every batch into its instance VBO
+static void UploadInstanceBatches(std::vector<InstanceBatch>& batches, GLenum usage) {
+    for (size_t i = 0; i < batches.size(); ++i) {
+        const std::vector<InstanceData>& instances = batches[i].instances;
+        glBindBuffer(GL_ARRAY_BUFFER, batches[i].instanceVbo);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.empty() ? NULL : &instances[0], usage);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//binds the shaders and sets the per frame uniforms, but only when switching programs
+static void UseBlockProgram(BlockProgram* program) {
+    if (gActiveProgram == program)
+        return;
+
+    gActiveProgram = program;
+    core::Program* shaders = program->shaders;
+    const BlockProgramHandles& handles = program->handles;
     shaders->use();
+    shaders->setUniform(handles.camera, gCamera.matrix());
+    shaders->setUniform(handles.materialTex, 0); //set to 0 because Render() binds the block textures to GL_TEXTURE0
+    shaders->setUniform(handles.cameraPosition, gCamera.position());
+}
 
-    //set the shader uniforms
-    shaders->setUniform("camera", gCamera.matrix());
-    shaders->setUniform("model", inst.transform);
-    shaders->setUniform("materialTex", 0); //set to 0 because the texture will be bound to GL_TEXTURE0
-    shaders->setUniform("materialShininess", asset->shininess);
-    shaders->setUniform("materialSpecularColor", asset->specularColor);
-    shaders->setUniform("cameraPosition", gCamera.position());
-    shaders->setUniform("numLights", (int)gLights.size());
+//sets the material uniforms of `asset`, its program must be in use
+static void ApplyMaterial(const ModelAsset* asset) {
+    core::Program* shaders = asset->program->shaders;
+    const BlockProgramHandles& handles = asset->program->handles;
+    shaders->setUniform(handles.materialShininess, asset->shininess);
+    shaders->setUniform(handles.materialSpecularColor, asset->specularColor);
+    //the lights come from the `Lights` uniform block, see UpdateLightBuffer()
+    //the texture is a layer of `gBlockTextures`, which stays bound for the whole frame
+}
 
-    for (size_t i = 0; i < gLights.size(); ++i) {
-        SetLightUniform(shaders, "position", i, gLights[i].position);
-        SetLightUniform(shaders, "intensities", i, gLights[i].intensities);
-        SetLightUniform(shaders, "attenuation", i, gLights[i].attenuation);
-        SetLightUniform(shaders, "ambientCoefficient", i, gLights[i].ambientCoefficient);
-        SetLightUniform(shaders, "coneAngle", i, gLights[i].coneAngle);
-        SetLightUniform(shaders, "coneDirection", i, gLights[i].coneDirection);
+//renders all instances of an `InstanceBatch` with one draw call
+static void RenderInstanceBatch(const InstanceBatch& batch) {
+    if (batch.instances.empty())
+        return;
+
+    core::Profiler::Scope profile(gProfiler, "RenderInstanceBatch");
+
+    ModelAsset* asset = batch.asset;
+    Mesh* mesh = asset->mesh;
+    const BlockProgramHandles& handles = asset->program->handles;
+
+    UseBlockProgram(asset->program);
+    ApplyMaterial(asset);
+
+    //bind VAO and point the per-instance "model" matrix (one vec4 attribute per column) and "vertLayer" at the batch VBO
+    glBindVertexArray(mesh->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceVbo);
+    GLint modelAttrib = handles.modelAttrib;
+    for (GLint column = 0; column < 4; ++column) {
+        glEnableVertexAttribArray(modelAttrib + column);
+        glVertexAttribPointer(modelAttrib + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (const GLvoid*)(offsetof(InstanceData, transform) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(modelAttrib + column, 1);
     }
+    glEnableVertexAttribArray(handles.layerAttrib);
+    glVertexAttribPointer(handles.layerAttrib, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (const GLvoid*)offsetof(InstanceData, layer));
+    glVertexAttribDivisor(handles.layerAttrib, 1);
 
+    //draw all instances
+    glDrawArraysInstanced(mesh->drawType, mesh->drawStart, mesh->drawCount, (GLsizei)batch.instances.size());
+    ++gDrawStats.drawCalls;
+    gDrawStats.triangles += (mesh->drawCount / 3) * batch.instances.size();
 
-    //bind the texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, asset->texture->object());
+    //unbind everything but the program, Render() releases that after the last batch
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+//true if any instance of `batch` may be inside `frustum`, every instance is a cube of BLOCK_SIZE
+static bool InstanceBatchVisible(const InstanceBatch& batch, const core::Frustum& frustum) {
+    if (batch.instances.empty())
+        return false;
+
+    //the instances may be rotated, so use the radius of the sphere around the cube
+    const GLfloat radius = 0.5f * BLOCK_SIZE * std::sqrt(3.0f);
+    glm::vec3 boundsMin(batch.instances[0].transform[3]);
+    glm::vec3 boundsMax(boundsMin);
+    for (size_t i = 1; i < batch.instances.size(); ++i) {
+        glm::vec3 origin(batch.instances[i].transform[3]);
+        boundsMin = glm::min(boundsMin, origin);
+        boundsMax = glm::max(boundsMax, origin);
+    }
+    return frustum.intersectsBox(boundsMin - glm::vec3(radius), boundsMax + glm::vec3(radius));
+}
+
+//renders the ranges of a chunk mesh, either the opaque or the transparent block types
+static void RenderChunkMesh(const ChunkMesh& mesh, bool transparent) {
+    core::Profiler::Scope profile(gProfiler, "RenderChunkMesh");
+
+    UseBlockProgram(mesh.program);
+
+    //the vertices are in world space, so "model" is the identity for all of them
+    glBindVertexArray(mesh.vao);
+    GLint modelAttrib = mesh.program->handles.modelAttrib;
+    for (GLint column = 0; column < 4; ++column) {
+        glm::vec4 identityColumn(0.0f);
+        identityColumn[column] = 1.0f;
+        glVertexAttrib4fv(modelAttrib + column, &identityColumn[0]);
+    }
+
+    for (size_t i = 0; i < mesh.ranges.size(); ++i) {
+        const core::ChunkMesher::Range& range = mesh.ranges[i];
+        if (range.transparent != transparent)
+            continue;
 
-    //bind VAO and draw
-    glBindVertexArray(asset->vao);
-    glDrawArrays(asset->drawType, asset->drawStart, asset->drawCount);
+        ApplyMaterial(AssetForBlockId(range.id));
+        glDrawArrays(GL_TRIANGLES, range.start, range.count);
+        ++gDrawStats.drawCalls;
+        gDrawStats.triangles += range.count / 3;
+    }
 
-    //unbind everything
     glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    shaders->stopUsing();
 }
 
 // draws a single frame
-static void Render() {
+static void Render(const FrameState& state) {
+    core::Profiler::Scope profile(gProfiler, "Render");
+
     // clear everything
     glClearColor(0.6, 0.8, 1.0, 1.0); // white -> we want white clouds :)
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // render all the instances
-    std::list<ModelInstance>::const_iterator it;
-    for (it = gInstances.begin(); it != gInstances.end(); ++it) {
-        RenderInstance(*it);
+    // the lights are shared by all programs through one uniform buffer
+    UpdateLightBuffer(state.lights);
+
+    // all block textures are layers of one texture array, bound once for the whole frame
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, gBlockTextures->object());
+
+    // the car moves every frame, so its batches are rebuilt and streamed again
+    BuildInstanceBatches(gCarInstances, state.carTransforms, gCarBatches);
+    UploadInstanceBatches(gCarBatches, GL_STREAM_DRAW);
+
+    // only chunks and batches that may end up on screen are drawn
+    core::Frustum frustum(gCamera.matrix());
+    gCullStats = CullStats();
+    gDrawStats = DrawStats();
+    gVisibleChunkMeshes.clear();
+    for (size_t i = 0; i < gChunkMeshes.size(); ++i) {
+        if (frustum.intersectsBox(gChunkMeshes[i].boundsMin, gChunkMeshes[i].boundsMax))
+            gVisibleChunkMeshes.push_back(&gChunkMeshes[i]);
+    }
+    gCullStats.visibleChunks = gVisibleChunkMeshes.size();
+    gCullStats.culledChunks = gChunkMeshes.size() - gVisibleChunkMeshes.size();
+
+    // render the opaque terrain, the car with one draw call per asset, and the see-through terrain last
+    {
+        core::Profiler::GpuScope gpuProfile(gProfiler, "Terrain opaque");
+        for (size_t i = 0; i < gVisibleChunkMeshes.size(); ++i) {
+            RenderChunkMesh(*gVisibleChunkMeshes[i], false);
+        }
+    }
+
+    {
+        core::Profiler::GpuScope gpuProfile(gProfiler, "Car");
+        for (size_t i = 0; i < gCarBatches.size(); ++i) {
+            if (gCarBatches[i].instances.empty())
+                continue;
+
+            if (!InstanceBatchVisible(gCarBatches[i], frustum)) {
+                ++gCullStats.culledBatches;
+                continue;
+            }
+            ++gCullStats.visibleBatches;
+            RenderInstanceBatch(gCarBatches[i]);
+        }
     }
 
-    std::list<ModelInstance>::const_iterator cit;
-    for (cit = gCarInstances.begin(); cit != gCarInstances.end(); ++cit) {
-        RenderInstance(*cit);
+    {
+        core::Profiler::GpuScope gpuProfile(gProfiler, "Terrain transparent");
+        for (size_t i = 0; i < gVisibleChunkMeshes.size(); ++i) {
+            RenderChunkMesh(*gVisibleChunkMeshes[i], true);
+        }
     }
 
-    std::list<ModelInstance>::const_iterator rit;
-    for (rit = gCarTireInstances.begin(); rit != gCarTireInstances.end(); ++rit) {
-        RenderInstance(*rit);
+    if (gActiveProgram) {
+        gActiveProgram->shaders->stopUsing();
+        gActiveProgram = NULL;
     }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
 
-    // swap the display buffers (displays what was just drawn)
-    glfwSwapBuffers(gWindow);
+// advances `state` by `secondsElapsed`, it touches nothing else so it can run on its own thread
+static void Simulate(SimulationState& state, float secondsElapsed) {
+    const GLfloat degreesPerSecond = 20.0f;
+    state.degreesRotated -= secondsElapsed * degreesPerSecond;
+    while (state.degreesRotated > 360.0f) state.degreesRotated -= 360.0f;
 }
 
-// update the scene based on the time elapsed since last update
+// the state `alpha` of the way from `previous` to `current`
+static SimulationState InterpolateSimulation(const SimulationState& previous, const SimulationState& current, float alpha) {
+    SimulationState state;
+    state.degreesRotated = glm::mix(previous.degreesRotated, current.degreesRotated, alpha);
+    return state;
+}
+
+// moves the car in `gSceneGraph` to where `state` has it
+static void ApplySimulation(const SimulationState& state) {
+    // only the car and the spin of its tires change, the graph recomputes just the nodes below them
+    PlaceCar(state.degreesRotated);
+    const glm::quat tireSpin = TireSpin(state.degreesRotated);
+    for (size_t i = 0; i < gCarTireNodes.size(); ++i)
+        gSceneGraph.setLocalTransform(gCarTireNodes[i], glm::vec3(0.0f), tireSpin);
+    gSceneGraph.update(*gJobs);
+}
+
+// update the scene based on the time elapsed since last update, in a single step
 static void Update(float secondsElapsed) {
-    // https://glm.g-truc.net/0.9.9/api/a00668.html#ga1a4ecc4ad82652b8fb14dcb087879284
-    // FOR EXAMPLE !!!! ***********************************************************
-    // // rotate the first Block in `gInstances`
-    const GLfloat degreesPerSecond = 20.0f;
-    gDegreesRotated -= secondsElapsed * degreesPerSecond;
-    while (gDegreesRotated > 360.0f) gDegreesRotated -= 360.0f;
-
-    std::list<ModelInstance>::iterator carElement;
-    for (carElement = gCarInstances.begin(); carElement != gCarInstances.end(); ++carElement) {
-        // Set the element to the mid of the map
-        carElement->transform = glm::translate(glm::mat4(), glm::vec3(30.0f, 2.0f, 30.0f));
-        // Rotate the element
-        carElement->transform *= glm::rotate(glm::mat4(), glm::radians(gDegreesRotated), glm::vec3(0, 1, 0));
-        // Set the element to the correct group position
-        carElement->transform *= glm::translate(glm::mat4(), carElement->transformInner);
-        // Set the element in the grup position to the final position in the map
-        carElement->transform *= glm::translate(glm::mat4(), glm::vec3(25.0f, 0.0f, 0.0f));
-        // *glm::rotate(glm::mat4(), glm::radians(gDegreesRotated), glm::vec3(0, 1, 0));
-        // cit->transform *= glm::translate(glm::mat4(), glm::vec3(27.0f, 0.0f, 0.0f));
-    }
-
-    // Rotate and translate the tires
-    std::list<ModelInstance>::iterator carTireElement;
-    for (carTireElement = gCarTireInstances.begin(); carTireElement != gCarTireInstances.end(); ++carTireElement) {
-        // Set the element to the mid of the map
-        carTireElement->transform = glm::translate(glm::mat4(), glm::vec3(30.0f, 2.0f, 30.0f));
-        // Rotate the element
-        carTireElement->transform *= glm::rotate(glm::mat4(), glm::radians(gDegreesRotated), glm::vec3(0, 1, 0));
-        // Set the element to the correct group position
-        carTireElement->transform *= glm::translate(glm::mat4(), carTireElement->transformInner);
-        carTireElement->transform *= glm::mat4() * glm::rotate(glm::mat4(), glm::radians(-gDegreesRotated*8), glm::vec3(1, 0, 0));
-        // Set the element in the grup position to the final position in the map
-        carTireElement->transform *= glm::translate(glm::mat4(), glm::vec3(25.0f, 0.0f, 0.0f));
-        // *glm::rotate(glm::mat4(), glm::radians(gDegreesRotated), glm::vec3(0, 1, 0));
-        // cit->transform *= glm::translate(glm::mat4(), glm::vec3(27.0f, 0.0f, 0.0f));
-    }
-
-
-    // gInstances.front().transform = glm::rotate(glm::mat4(), glm::radians(gDegreesRotated), glm::vec3(0, 1, 0));
-    // gCarInstances.front().transform = glm::translate(glm::mat4(), glm::vec3(30.0f, 2.0f, 30.0f)) * glm::rotate(glm::mat4(), glm::radians(gDegreesRotated), glm::vec3(0, 1, 0));
-    // gCarInstances.front().transform *= glm::translate(glm::mat4(), glm::vec3(27.0f, 0.0f, 0.0f));
+    Simulate(gSimulation, secondsElapsed);
+    ApplySimulation(gSimulation);
+}
+
+// copies what rendering needs out of the scene, so the next update can go on while it renders
+static void WriteFrameState(FrameState& state) {
+    state.carTransforms.resize(gCarInstances.size());
+    for (size_t i = 0; i < gCarInstances.size(); ++i)
+        state.carTransforms[i] = gSceneGraph.worldTransform(gCarInstances[i].node);
+    state.lights = PackLights();
+}
+
+// the update stage of a frame as a job for the FramePipeline, `simulate` moves the scene.
+// it may run on the pipeline's thread, so it only shows up in the trace, not in `gProfiler`
+static core::FramePipeline<FrameState>::Update UpdateJob(const std::function<void()>& simulate) {
+    return [simulate](FrameState& state) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        simulate();
+        WriteFrameState(state);
+        if (core::Trace::enabled())
+            core::Trace::record("Update", start, std::chrono::steady_clock::now());
+    };
+}
+
+// the most steps a frame may catch up on, the time beyond that is dropped
+const int MAX_SIMULATION_STEPS = 8;
+
+// runs Simulate() in fixed steps on its own thread, see --sim-thread.
+// the frames take the last two steps and blend them by how much time has passed since
+class SimulationThread {
+public:
+    SimulationThread(const SimulationState& state, double stepSeconds) :
+        _stepSeconds(stepSeconds),
+        _stopping(false),
+        _previous(state),
+        _current(state),
+        _currentTime(std::chrono::steady_clock::now())
+    {
+        _thread = std::thread(&SimulationThread::_run, this);
+    }
+
+    ~SimulationThread() {
+        _stopping = true;
+        _thread.join();
+    }
+
+    // the state to show at this moment
+    SimulationState sample() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        double sinceStep = std::chrono::duration<double>(std::chrono::steady_clock::now() - _currentTime).count();
+        return InterpolateSimulation(_previous, _current, glm::clamp((float)(sinceStep / _stepSeconds), 0.0f, 1.0f));
+    }
+
+private:
+    double _stepSeconds;
+    std::atomic<bool> _stopping;
+    std::thread _thread;
+    std::mutex _mutex;
+    SimulationState _previous;
+    SimulationState _current;
+    std::chrono::steady_clock::time_point _currentTime; // when `_current` is due to be shown
+
+    void _run() {
+        core::Trace::setThreadName("simulation");
+        core::FixedTimestep timestep(_stepSeconds, MAX_SIMULATION_STEPS);
+        SimulationState state = _current;
+        std::chrono::steady_clock::time_point lastTime = std::chrono::steady_clock::now();
+        while (!_stopping) {
+            // sleep until the next step is due
+            std::this_thread::sleep_for(std::chrono::duration<double>(_stepSeconds * (1.0 - timestep.alpha())));
+
+            std::chrono::steady_clock::time_point thisTime = std::chrono::steady_clock::now();
+            int steps = timestep.advance(std::chrono::duration<double>(thisTime - lastTime).count());
+            lastTime = thisTime;
+            if (steps == 0)
+                continue;
+
+            SimulationState previous = state;
+            for (int i = 0; i < steps; ++i) {
+                previous = state;
+                Simulate(state, (float)_stepSeconds);
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _previous = previous;
+            _current = state;
+            _currentTime = thisTime - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timestep.alpha() * _stepSeconds));
+        }
+    }
+};
+
+// move the camera, lights and settings based on keyboard and mouse, only called when there is a window
+static void ProcessInput(float secondsElapsed) {
+    core::Profiler::Scope profile(gProfiler, "ProcessInput");
 
     //move position of camera based on WASD keys, and XZ keys for up and down
     const float moveSpeed = 4.0; //units per second
@@ -1007,6 +1727,25 @@ static void Update(float secondsElapsed) {
         gCamera.offsetPosition(secondsElapsed * moveSpeed * glm::vec3(0, 1, 0));
     }
 
+    //switch between the naive and the greedy terrain mesh, once per key press
+    bool meshModeKeyDown = glfwGetKey(gWindow, 'G') == GLFW_PRESS;
+    if (meshModeKeyDown && !gMeshModeKeyDown) {
+        gTerrainMeshMode = (gTerrainMeshMode == core::ChunkMesher::GREEDY) ? core::ChunkMesher::NAIVE : core::ChunkMesher::GREEDY;
+        DeleteChunkMeshes(gChunkMeshes);
+        BuildChunkMeshes(gWorld, gTerrainMeshMode, gChunkMeshes, true);
+    }
+    gMeshModeKeyDown = meshModeKeyDown;
+
+    //write what has been traced so far, once per key press
+    bool traceKeyDown = glfwGetKey(gWindow, 'T') == GLFW_PRESS;
+    if (traceKeyDown && !gTraceKeyDown) {
+        if (gTraceFile.empty())
+            std::cout << "Tracing is off, start with --trace FILE" << std::endl;
+        else
+            std::cout << "Trace: " << core::Trace::write(gTraceFile) << " events written to " << gTraceFile << std::endl;
+    }
+    gTraceKeyDown = traceKeyDown;
+
     //move light
     if (glfwGetKey(gWindow, '1')) {
         gLights[0].position = glm::vec4(gCamera.position(), 1.0);
@@ -1059,29 +1798,248 @@ void SetupCamera() {
     gCamera.offsetOrientation(0.0, 180.0);
 }
 
-// Here is the Main, the program starts here and initialize everything...
-void AppMain() {
-    // initialise GLFW
-    glfwSetErrorCallback(OnError);
-    if (!glfwInit())
-        throw std::runtime_error("glfwInit failed");
+// command line options, see ParseOptions()
+struct AppOptions {
+    bool headless;
+    int frames;            // headless only: number of frames to render, samples per pixel for the path tracer
+    int dumpEvery;         // headless only: write every n-th frame (and the last one) as PNG, 0 = never
+    std::string frameDir;  // headless only: directory the PNGs are written to, must exist
+    std::string traceFile; // if set, all sections are traced and written to this file on exit
+    std::string scene;     // see CreateScene()
+    std::string pathFile;  // headless only: camera path to fly along instead of circling the scene
+    std::string recordPathFile; // windowed only: the camera flight is saved to this file on exit
+    std::string reportFile;     // if set, the headless run is a benchmark and writes a JSON report
+    std::string renderer;  // headless only: "gl", "software", "raycast" or "pathtrace"
+    bool pipeline;         // update the next frame on a thread of its own while the current one renders
+    bool bakeTextures;     // only write the texture files of the block textures and exit
+    int warmupFrames;      // benchmark only: frames rendered before the measurement starts
+    int simulationRate;    // windowed only: simulation steps per second, the frames blend between them
+    bool simulationThread; // windowed only: simulate on a thread of its own instead of before each frame
+    int width;
+    int height;
+
+    AppOptions() :
+        headless(false),
+        frames(120),
+        dumpEvery(30),
+        frameDir("."),
+        scene("maze"),
+        renderer("gl"),
+        pipeline(false),
+        bakeTextures(false),
+        warmupFrames(0),
+        simulationRate(60),
+        simulationThread(false),
+        width((int)SCREEN_SIZE.x),
+        height((int)SCREEN_SIZE.y)
+    {}
+};
 
-    // open a window with GLFW
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-    gWindow = glfwCreateWindow((int)SCREEN_SIZE.x, (int)SCREEN_SIZE.y, "OpenGL Tutorial", NULL, NULL);
-    if (!gWindow)
-        throw std::runtime_error("glfwCreateWindow failed. Can your hardware handle OpenGL 3.2?");
+static int ParsePositiveInt(const std::string& option, const char* value, bool allowZero) {
+    char* end = NULL;
+    long result = std::strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || result < (allowZero ? 0 : 1) || result > 1000000)
+        throw std::runtime_error("Invalid value for " + option + ": " + value);
+    return (int)result;
+}
 
-    // GLFW settings
-    glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glfwSetCursorPos(gWindow, 0, 0);
-    glfwSetScrollCallback(gWindow, OnScroll);
-    glfwMakeContextCurrent(gWindow);
+// [--headless [--frames N] [--dump-every N] [--frame-dir DIR] [--path FILE]] [--record-path FILE]
+// [--benchmark REPORT [--warmup N]] [--renderer gl|software|raycast|pathtrace] [--scene NAME] [--size WIDTHxHEIGHT] [--trace FILE]
+// [--sim-rate HZ] [--sim-thread] [--pipeline]
+// or --bake-textures
+static AppOptions ParseOptions(int argc, char* argv[]) {
+    AppOptions options;
+    bool framesGiven = false;
+    bool dumpEveryGiven = false;
+    bool warmupGiven = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if (arg == "--headless") {
+            options.headless = true;
+        }
+        else if (arg == "--frames" && hasValue) {
+            options.frames = ParsePositiveInt(arg, argv[++i], false);
+            framesGiven = true;
+        }
+        else if (arg == "--dump-every" && hasValue) {
+            options.dumpEvery = ParsePositiveInt(arg, argv[++i], true);
+            dumpEveryGiven = true;
+        }
+        else if (arg == "--frame-dir" && hasValue) {
+            options.frameDir = argv[++i];
+        }
+        else if (arg == "--trace" && hasValue) {
+            options.traceFile = argv[++i];
+        }
+        else if (arg == "--renderer" && hasValue) {
+            options.renderer = argv[++i];
+            if (options.renderer != "gl" && options.renderer != "software" && options.renderer != "raycast" && options.renderer != "pathtrace")
+                throw std::runtime_error("Unknown renderer " + options.renderer + ", use gl, software, raycast or pathtrace");
+        }
+        else if (arg == "--scene" && hasValue) {
+            options.scene = argv[++i];
+        }
+        else if (arg == "--path" && hasValue) {
+            options.pathFile = argv[++i];
+        }
+        else if (arg == "--record-path" && hasValue) {
+            options.recordPathFile = argv[++i];
+        }
+        else if (arg == "--benchmark" && hasValue) {
+            options.reportFile = argv[++i];
+        }
+        else if (arg == "--warmup" && hasValue) {
+            options.warmupFrames = ParsePositiveInt(arg, argv[++i], true);
+            warmupGiven = true;
+        }
+        else if (arg == "--sim-rate" && hasValue) {
+            options.simulationRate = ParsePositiveInt(arg, argv[++i], false);
+        }
+        else if (arg == "--sim-thread") {
+            options.simulationThread = true;
+        }
+        else if (arg == "--pipeline") {
+            options.pipeline = true;
+        }
+        else if (arg == "--bake-textures") {
+            options.bakeTextures = true;
+        }
+        else if (arg == "--size" && hasValue) {
+            std::string size = argv[++i];
+            size_t x = size.find('x');
+            if (x == std::string::npos)
+                throw std::runtime_error("--size expects WIDTHxHEIGHT, got " + size);
+            options.width = ParsePositiveInt(arg, size.substr(0, x).c_str(), false);
+            options.height = ParsePositiveInt(arg, size.substr(x + 1).c_str(), false);
+        }
+        else {
+            throw std::runtime_error("Unknown or incomplete argument: " + arg);
+        }
+    }
+
+    // a benchmark is a headless run that by default warms up and writes no images
+    if (!options.reportFile.empty()) {
+        options.headless = true;
+        if (!dumpEveryGiven)
+            options.dumpEvery = 0;
+        if (!warmupGiven)
+            options.warmupFrames = 10;
+    }
+
+    // the window shows what GL draws, so only headless runs can use the CPU renderers
+    if (options.renderer != "gl" && !options.headless)
+        throw std::runtime_error("--renderer " + options.renderer + " needs --headless or --benchmark");
+
+    // headless runs simulate one step of the same length per frame, so they are reproducible
+    if (options.headless && options.simulationThread)
+        throw std::runtime_error("--sim-thread only works with a window");
+
+    // the path tracer refines a single image, there are no frames to measure
+    if (options.renderer == "pathtrace" && !options.reportFile.empty())
+        throw std::runtime_error("--renderer pathtrace cannot be used with --benchmark");
+    if (options.renderer == "pathtrace" && options.pipeline)
+        throw std::runtime_error("--renderer pathtrace cannot be used with --pipeline");
+
+    // a recorded path is played back completely unless the number of frames is given
+    if (!options.pathFile.empty() && !framesGiven)
+        options.frames = -1;
+    return options;
+}
+
+// flies the camera once around the maze, `t` goes from 0 to 1 over the whole headless run
+static void UpdateScriptedCamera(float t) {
+    const glm::vec3 center = gScene.center;
+    const float radius = gScene.radius;
+    const float angle = glm::radians(360.0f * t);
+    const float height = radius * (0.375f + 0.125f * std::sin(2.0f * angle));
+    gCamera.setPosition(center + glm::vec3(radius * std::cos(angle), height, radius * std::sin(angle)));
+    gCamera.lookAt(center);
+}
+
+// positions the camera for headless frame `frame`, on the recorded path if there is one, otherwise circling the scene
+static void PlaceHeadlessCamera(const core::CameraPath& path, int frame, int frameCount, float secondsPerFrame) {
+    if (path.keyframeCount() == 0) {
+        UpdateScriptedCamera((float)frame / (float)frameCount);
+        return;
+    }
+
+    core::CameraPath::Keyframe keyframe = path.sample((float)frame * secondsPerFrame);
+    gCamera.setPosition(keyframe.position);
+    if (keyframe.target != keyframe.position)
+        gCamera.lookAt(keyframe.target);
+}
+
+// nearest rank percentile of the sorted values, `percent` from 0 to 100
+static double Percentile(const std::vector<double>& sorted, double percent) {
+    size_t rank = (size_t)std::ceil(percent / 100.0 * (double)sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// writes the results of a benchmark run as JSON, all times in milliseconds
+static void WriteBenchmarkReport(const AppOptions& options, float secondsPerFrame, double loadMilliseconds,
+                                 const std::vector<double>& frameTimes, const DrawStats& drawTotals) {
+    std::ofstream report(options.reportFile.c_str(), std::ios::out | std::ios::trunc);
+    if (!report)
+        throw std::runtime_error("Could not open benchmark report: " + options.reportFile);
+
+    std::vector<double> sorted(frameTimes);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < sorted.size(); ++i)
+        sum += sorted[i];
+    double frames = (double)frameTimes.size();
+
+    report << "{\n"
+           << "  \"scene\": \"" << gScene.name << "\",\n"
+           << "  \"renderer\": \"" << options.renderer << "\",\n"
+           << "  \"cameraPath\": \"" << (options.pathFile.empty() ? "orbit" : options.pathFile) << "\",\n"
+           << "  \"terrainMeshMode\": \"" << (gTerrainMeshMode == core::ChunkMesher::GREEDY ? "greedy" : "naive") << "\",\n"
+           << "  \"width\": " << options.width << ",\n"
+           << "  \"height\": " << options.height << ",\n"
+           << "  \"frames\": " << frameTimes.size() << ",\n"
+           << "  \"warmupFrames\": " << options.warmupFrames << ",\n"
+           << "  \"timestepMs\": " << 1000.0 * secondsPerFrame << ",\n"
+           << "  \"loadMs\": " << loadMilliseconds << ",\n"
+           << "  \"frameMs\": { \"min\": " << sorted.front() << ", \"avg\": " << sum / frames
+           << ", \"p50\": " << Percentile(sorted, 50.0) << ", \"p90\": " << Percentile(sorted, 90.0)
+           << ", \"p95\": " << Percentile(sorted, 95.0) << ", \"p99\": " << Percentile(sorted, 99.0)
+           << ", \"max\": " << sorted.back() << " },\n"
+           << "  \"drawCallsPerFrame\": " << (double)drawTotals.drawCalls / frames << ",\n"
+           << "  \"trianglesPerFrame\": " << (double)drawTotals.triangles / frames << ",\n"
+           << "  \"rayStepsPerFrame\": " << (double)drawTotals.raySteps / frames << ",\n"
+           << "  \"terrainTriangles\": " << gTerrainTriangles << ",\n"
+           << "  \"blocks\": " << gWorld.blockCount() << ",\n"
+           << "  \"chunks\": " << gWorld.chunks().size() << ",\n"
+           << "  \"memory\": { \"peakResidentBytes\": " << PeakMemoryUsage()
+           << ", \"terrainMeshBytes\": " << gTerrainMeshBytes << ", \"textureBytes\": " << gTextureBytes << " },\n"
+           << "  \"frameTimesMs\": [";
+    for (size_t i = 0; i < frameTimes.size(); ++i)
+        report << (i > 0 ? ", " : "") << frameTimes[i];
+    report << "]\n}\n";
+
+    if (!report)
+        throw std::runtime_error("Could not write benchmark report: " + options.reportFile);
+    std::cout << "Benchmark: " << gScene.name << ", " << frameTimes.size() << " frames, avg " << sum / frames
+              << " ms, p99 " << Percentile(sorted, 99.0) << " ms, report written to " << options.reportFile << std::endl;
+}
+
+// creates the car, the world, the camera and the lights, everything that does not depend on GL
+static void CreateSceneContents(const std::string& sceneName) {
+    // create all the instances in the 3D scene
+    CreateCar();
+    CreateScene(sceneName);
+    std::cout << "Terrain: " << gWorld.blockCount() << " blocks in " << gWorld.chunks().size() << " chunks" << std::endl;
+
+    // Creates the Camera
+    SetupCamera();
+    gCamera.setNearAndFarPlanes(0.5f, gScene.farPlane);
 
+    CreateAllLights();
+}
+
+// checks the driver and sets up everything the scene needs, the GL context must be current
+static void InitScene(const std::string& sceneName) {
     glClearColor(0.41, 0.41, 0.41, 1.0);
     // initialise GLEW
     glewExperimental = GL_TRUE; //stops glew crashing on OSX :-/
@@ -1097,9 +2055,9 @@ void AppMain() {
     std::cout << "Vendor: " << glGetString(GL_VENDOR) << std::endl;
     std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
 
-    // make sure OpenGL version 3.2 API is available
-    if (!GLEW_VERSION_3_2)
-        throw std::runtime_error("OpenGL 3.2 API is not available.");
+    // make sure OpenGL version 3.3 API is available (needed for instanced vertex attributes)
+    if (!GLEW_VERSION_3_3)
+        throw std::runtime_error("OpenGL 3.3 API is not available.");
 
     // OpenGL settings
     glEnable(GL_DEPTH_TEST);
@@ -1107,37 +2065,523 @@ void AppMain() {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // Load all textures once !
-    LoadTextures();
+    // the textures decode on `gJobs` while the rest of the scene is set up, they are uploaded last
+    core::BitmapLoader textureLoader(*gJobs);
+    std::vector<PendingTextureLayer> pendingTextures;
+    StartLoadingTextures(textureLoader, pendingTextures);
 
     // initialise the gExampleModelAsset asset
     LoadExampleAssets();
 
     // initialise all different block types and push them into the vector "blocks"
     LoadAllBlockTypes();
+    LoadBlockMeshes();
 
-    // create all the instances in the 3D scene based on the gExampleModelAsset asset
-    CreateCar();
-    CreateTerrain();
+    CreateSceneContents(sceneName);
 
-    // Creates the Camera
-    SetupCamera();
+    // the terrain never moves, so it is meshed and uploaded once
+    BuildChunkMeshes(gWorld, gTerrainMeshMode, gChunkMeshes, true);
 
-    CreateAllLights();
+    gLightBuffer = new core::UniformBuffer(sizeof(LightBlock), LIGHT_BLOCK_BINDING);
+
+    // Load all textures once !
+    LoadTextures(textureLoader, pendingTextures);
+}
+
+// sets up the scene for the software renderer, without touching GL
+static void InitSoftwareScene(const std::string& sceneName, std::vector<core::Bitmap>& textureLayers) {
+    LoadTextureLayers(textureLayers);
+    LoadAllBlockTypes();
+    CreateSceneContents(sceneName);
+    BuildChunkMeshes(gWorld, gTerrainMeshMode, gChunkMeshes, false);
+}
+
+// the material of a block type for the CPU renderers
+static core::Shading::Material SoftwareMaterial(const ModelAsset* asset, bool transparent) {
+    core::Shading::Material material;
+    material.textureLayer = (int)asset->textureLayer;
+    material.shininess = asset->shininess;
+    material.specularColor = asset->specularColor;
+    material.transparent = transparent;
+    return material;
+}
+
+// CUBE_VERTEX_DATA as rasterizer vertices
+static std::vector<core::Rasterizer::Vertex> SoftwareCubeVertices() {
+    const size_t floatsPerVertex = 8;
+    std::vector<core::Rasterizer::Vertex> vertices(sizeof(CUBE_VERTEX_DATA) / sizeof(GLfloat) / floatsPerVertex);
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        const GLfloat* data = &CUBE_VERTEX_DATA[i * floatsPerVertex];
+        vertices[i].position = glm::vec3(data[0], data[1], data[2]);
+        vertices[i].texCoord = glm::vec2(data[3], data[4]);
+        vertices[i].normal = glm::vec3(data[5], data[6], data[7]);
+    }
+    return vertices;
+}
+
+// the lights of the scene as the CPU renderers take them, the same as UpdateLightBuffer() uploads
+static std::vector<core::Shading::Light> SoftwareLights(const LightBlock& lightBlock) {
+    std::vector<core::Shading::Light> lights(lightBlock.numLights);
+    for (size_t i = 0; i < lights.size(); ++i) {
+        lights[i].position = lightBlock.allLights[i].position;
+        lights[i].intensities = lightBlock.allLights[i].intensities;
+        lights[i].attenuation = lightBlock.allLights[i].attenuation;
+        lights[i].ambientCoefficient = lightBlock.allLights[i].ambientCoefficient;
+        lights[i].coneCosine = lightBlock.allLights[i].coneCosine;
+        lights[i].coneDirection = lightBlock.allLights[i].coneDirection;
+    }
+    return lights;
+}
+
+// draws the same frame as Render() with the software rasterizer
+static void RenderSoftware(core::Rasterizer& rasterizer, const std::vector<core::Rasterizer::Vertex>& cubeVertices, const FrameState& state) {
+    core::Profiler::Scope profile(gProfiler, "RenderSoftware");
+
+    rasterizer.beginFrame(gCamera.matrix(), gCamera.position(), SoftwareLights(state.lights), glm::vec3(0.6f, 0.8f, 1.0f));
+    gDrawStats = DrawStats();
+
+    core::Frustum frustum(gCamera.matrix());
+    gVisibleChunkMeshes.clear();
+    for (size_t i = 0; i < gChunkMeshes.size(); ++i) {
+        if (frustum.intersectsBox(gChunkMeshes[i].boundsMin, gChunkMeshes[i].boundsMax))
+            gVisibleChunkMeshes.push_back(&gChunkMeshes[i]);
+    }
+
+    // the same order as Render(): opaque terrain, the car, see-through terrain
+    const glm::mat4 identity;
+    for (int pass = 0; pass < 2; ++pass) {
+        bool transparent = (pass == 1);
+        for (size_t i = 0; i < gVisibleChunkMeshes.size(); ++i) {
+            const ChunkMesh& mesh = *gVisibleChunkMeshes[i];
+            for (size_t r = 0; r < mesh.ranges.size(); ++r) {
+                const core::ChunkMesher::Range& range = mesh.ranges[r];
+                if (range.transparent != transparent)
+                    continue;
+
+                rasterizer.draw(&mesh.softwareVertices[range.start], range.count, identity, SoftwareMaterial(AssetForBlockId(range.id), transparent));
+                ++gDrawStats.drawCalls;
+            }
+        }
+
+        if (transparent)
+            break;
+
+        for (size_t i = 0; i < gCarInstances.size(); ++i) {
+            // GL blends the car's window too, it is drawn after the opaque terrain there as well
+            const ModelInstance& instance = gCarInstances[i];
+            bool window = (instance.asset == AssetForBlockId(BlockIdForIndex(CLOUD)));
+            rasterizer.draw(&cubeVertices[0], cubeVertices.size(), state.carTransforms[i], SoftwareMaterial(instance.asset, window));
+            ++gDrawStats.drawCalls;
+        }
+    }
+
+    rasterizer.endFrame();
+    gDrawStats.triangles = rasterizer.triangleCount();
+}
+
+// the blocks of `gWorld` with their materials, for the CPU renderers that trace rays
+static void InitVoxelScene(core::VoxelScene& scene) {
+    for (size_t i = 0; i < blocks.size(); ++i)
+        scene.setBlock(BlockIdForIndex((int)i), SoftwareMaterial(&blocks[i], i == CLOUD));
+    scene.setWorld(gWorld, BLOCK_SIZE);
+}
+
+// the car as boxes, they move every frame
+static void UpdateVoxelSceneBoxes(core::VoxelScene& scene, const FrameState& state) {
+    scene.clearBoxes();
+    for (size_t i = 0; i < gCarInstances.size(); ++i) {
+        const ModelInstance& instance = gCarInstances[i];
+        bool window = (instance.asset == AssetForBlockId(BlockIdForIndex(CLOUD)));
+        scene.addBox(state.carTransforms[i], SoftwareMaterial(instance.asset, window));
+    }
+}
+
+// casts a ray through `gWorld` for every pixel, the car is added as boxes
+static void RenderRaycast(core::VoxelRaycaster& raycaster, core::VoxelScene& scene, const FrameState& state) {
+    core::Profiler::Scope profile(gProfiler, "RenderRaycast");
+
+    raycaster.beginFrame(gCamera.matrix(), gCamera.position(), SoftwareLights(state.lights), glm::vec3(0.6f, 0.8f, 1.0f));
+    gDrawStats = DrawStats();
+
+    UpdateVoxelSceneBoxes(scene, state);
+    raycaster.render(scene);
+    gDrawStats.raySteps = raycaster.stepCount();
+}
+
+// turns the scene into pixels, either with OpenGL or on the CPU, see --renderer
+class Renderer {
+public:
+    virtual ~Renderer() {}
+
+    virtual void render(const FrameState& state) = 0;
+
+    // waits until the last frame is completely drawn
+    virtual void finish() = 0;
+
+    virtual core::Bitmap readPixels() const = 0;
+};
+
+// Render() into an offscreen framebuffer
+class GLRenderer : public Renderer {
+public:
+    GLRenderer(const std::string& sceneName, int width, int height) {
+        InitScene(sceneName);
+        _framebuffer.reset(new core::Framebuffer(width, height));
+        _framebuffer->bind();
+    }
+
+    ~GLRenderer() {
+        gProfiler.deleteQueries();
+    }
+
+    void render(const FrameState& state) {
+        Render(state);
+
+        // check for errors
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR)
+            std::cerr << "OpenGL Error " << error << std::endl;
+    }
+
+    void finish() {
+        glFinish();
+    }
+
+    core::Bitmap readPixels() const {
+        return _framebuffer->readPixels();
+    }
+
+private:
+    core::OffscreenContext _context; // first member, so it is created before and destroyed after everything else
+    std::unique_ptr<core::Framebuffer> _framebuffer;
+};
+
+// RenderSoftware() on all cores, no GL needed at all
+class SoftwareRenderer : public Renderer {
+public:
+    SoftwareRenderer(const std::string& sceneName, int width, int height) :
+        _rasterizer(width, height, _threadPool)
+    {
+        std::vector<core::Bitmap> textureLayers;
+        InitSoftwareScene(sceneName, textureLayers);
+        _rasterizer.setTextures(textureLayers);
+        _cubeVertices = SoftwareCubeVertices();
+        std::cout << "Software renderer: " << _threadPool.threadCount() << " threads" << std::endl;
+    }
+
+    void render(const FrameState& state) {
+        RenderSoftware(_rasterizer, _cubeVertices, state);
+    }
+
+    void finish() {}
+
+    core::Bitmap readPixels() const {
+        return _rasterizer.readPixels();
+    }
+
+private:
+    core::ThreadPool _threadPool;
+    core::Rasterizer _rasterizer;
+    std::vector<core::Rasterizer::Vertex> _cubeVertices;
+};
+
+// RenderRaycast() on all cores, needs neither GL nor terrain meshes
+class RaycastRenderer : public Renderer {
+public:
+    RaycastRenderer(const std::string& sceneName, int width, int height) :
+        _raycaster(width, height, _threadPool)
+    {
+        std::vector<core::Bitmap> textureLayers;
+        LoadTextureLayers(textureLayers);
+        LoadAllBlockTypes();
+        CreateSceneContents(sceneName);
+        _raycaster.setTextures(textureLayers);
+        InitVoxelScene(_scene);
+        std::cout << "Ray caster: " << _threadPool.threadCount() << " threads" << std::endl;
+    }
+
+    void render(const FrameState& state) {
+        RenderRaycast(_raycaster, _scene, state);
+    }
+
+    void finish() {}
+
+    core::Bitmap readPixels() const {
+        return _raycaster.readPixels();
+    }
+
+private:
+    core::ThreadPool _threadPool;
+    core::VoxelRaycaster _raycaster;
+    core::VoxelScene _scene;
+};
+
+// renders a fixed number of frames along a camera path into an offscreen framebuffer, and measures them for a benchmark
+static void RunHeadless(const AppOptions& options) {
+    std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+    std::unique_ptr<Renderer> renderer;
+    if (options.renderer == "software")
+        renderer.reset(new SoftwareRenderer(options.scene, options.width, options.height));
+    else if (options.renderer == "raycast")
+        renderer.reset(new RaycastRenderer(options.scene, options.width, options.height));
+    else
+        renderer.reset(new GLRenderer(options.scene, options.width, options.height));
+    double loadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+
+    gCamera.setViewportAspectRatio((float)options.width / (float)options.height);
+
+    // every frame advances the scene by the same step, so runs are reproducible
+    const float secondsPerFrame = 1.0f / 60.0f;
+    core::CameraPath path;
+    int frameCount = options.frames;
+    if (!options.pathFile.empty()) {
+        path = core::CameraPath::pathFromFile(options.pathFile);
+        if (frameCount < 0)
+            frameCount = (int)std::ceil(path.duration() / secondsPerFrame) + 1;
+    }
+
+    // a benchmark waits for the GPU after every frame, so the frame times include the rendering
+    const bool benchmark = !options.reportFile.empty();
+    std::vector<double> frameTimes;
+    DrawStats drawTotals;
+
+    // the update of a frame starts before the previous frame renders, with --pipeline both run at once.
+    // the camera is not part of the update, so the frames are the same either way
+    core::FramePipeline<FrameState> pipeline(options.pipeline);
+    const core::FramePipeline<FrameState>::Update updateJob = UpdateJob([secondsPerFrame]() { Update(secondsPerFrame); });
+    pipeline.beginUpdate(updateJob);
+
+    // the warmup frames are not timed, the clock starts with frame 0
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int frame = -options.warmupFrames; frame < frameCount; ++frame) {
+        if (frame == 0)
+            start = std::chrono::steady_clock::now();
+        gProfiler.beginFrame();
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+        {
+            core::Profiler::Scope profile(gProfiler, "Frame");
+            {
+                core::Profiler::Scope waitProfile(gProfiler, "WaitForUpdate");
+                pipeline.waitForUpdate();
+            }
+            pipeline.swap();
+            PlaceHeadlessCamera(path, std::max(frame, 0), frameCount, secondsPerFrame);
+            if (frame + 1 < frameCount) {
+                core::Profiler::Scope updateProfile(gProfiler, "Update");
+                pipeline.beginUpdate(updateJob);
+            }
+            renderer->render(pipeline.front());
+            if (benchmark)
+                renderer->finish();
+        }
+        if (frame >= 0) {
+            frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+            drawTotals.drawCalls += gDrawStats.drawCalls;
+            drawTotals.triangles += gDrawStats.triangles;
+            drawTotals.raySteps += gDrawStats.raySteps;
+        }
+
+        bool lastFrame = (frame + 1 == frameCount);
+        if (frame >= 0 && options.dumpEvery > 0 && (frame % options.dumpEvery == 0 || lastFrame)) {
+            core::Profiler::Scope profile(gProfiler, "WritePNG");
+            char filename[32];
+            snprintf(filename, sizeof(filename), "frame_%05d.png", frame);
+            renderer->readPixels().writeToPNGFile(options.frameDir + "/" + filename);
+        }
+        gProfiler.endFrame();
+    }
+    renderer->finish();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Headless: " << frameCount << " frames in " << seconds << " s, "
+              << 1000.0 * seconds / frameCount << " ms per frame (including PNG writes)" << std::endl;
+    gProfiler.print(std::cout);
+
+    if (benchmark)
+        WriteBenchmarkReport(options, secondsPerFrame, loadMilliseconds, frameTimes, drawTotals);
+}
+
+// path traces the first headless frame into a reference image, every frame adds one sample per pixel
+static void RunPathTracer(const AppOptions& options) {
+    core::ThreadPool threadPool;
+    core::PathTracer pathTracer(options.width, options.height, threadPool);
+    core::VoxelScene scene;
+    {
+        std::vector<core::Bitmap> textureLayers;
+        LoadTextureLayers(textureLayers);
+        LoadAllBlockTypes();
+        CreateSceneContents(options.scene);
+        pathTracer.setTextures(textureLayers);
+        InitVoxelScene(scene);
+    }
+    std::cout << "Path tracer: " << threadPool.threadCount() << " threads" << std::endl;
+
+    // the scene as the other renderers show it in their first headless frame
+    const float secondsPerFrame = 1.0f / 60.0f;
+    core::CameraPath path;
+    if (!options.pathFile.empty())
+        path = core::CameraPath::pathFromFile(options.pathFile);
+    const int sampleCount = (options.frames > 0) ? options.frames : 1;
+    gCamera.setViewportAspectRatio((float)options.width / (float)options.height);
+    PlaceHeadlessCamera(path, 0, sampleCount, secondsPerFrame);
+    Update(secondsPerFrame);
+    FrameState state;
+    WriteFrameState(state);
+    UpdateVoxelSceneBoxes(scene, state);
+
+    // the clear color of Render() as the light of the sky, linear like the samples
+    const glm::vec3 skyColor = glm::pow(glm::vec3(0.6f, 0.8f, 1.0f), glm::vec3(2.2f));
+    pathTracer.reset(gCamera.matrix(), SoftwareLights(state.lights), skyColor);
+
+    double traceSeconds = 0.0;
+    for (int sample = 0; sample < sampleCount; ++sample) {
+        gProfiler.beginFrame();
+        {
+            core::Profiler::Scope profile(gProfiler, "PathTrace");
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            pathTracer.iterate(scene);
+            traceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // the snapshots are named after the number of samples per pixel they contain
+        int samples = sample + 1;
+        if (options.dumpEvery > 0 && (samples % options.dumpEvery == 0 || samples == sampleCount)) {
+            core::Profiler::Scope profile(gProfiler, "WritePNG");
+            char filename[32];
+            snprintf(filename, sizeof(filename), "pathtrace_%05d.png", samples);
+            pathTracer.readPixels().writeToPNGFile(options.frameDir + "/" + filename);
+        }
+        gProfiler.endFrame();
+    }
+
+    double pixelSamples = (double)options.width * (double)options.height * (double)pathTracer.sampleCount();
+    std::cout << "Path tracer: " << pathTracer.sampleCount() << " samples per pixel in " << traceSeconds << " s, "
+              << pixelSamples / traceSeconds << " samples/s, "
+              << (double)pathTracer.rayCount() / traceSeconds << " rays/s" << std::endl;
+    gProfiler.print(std::cout);
+}
+
+// opens the window and runs until it is closed or escape is pressed
+static void RunWindowed(const AppOptions& options) {
+    // initialise GLFW
+    glfwSetErrorCallback(OnError);
+    if (!glfwInit())
+        throw std::runtime_error("glfwInit failed");
+
+    // open a window with GLFW
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    gWindow = glfwCreateWindow(options.width, options.height, "OpenGL Tutorial", NULL, NULL);
+    if (!gWindow)
+        throw std::runtime_error("glfwCreateWindow failed. Can your hardware handle OpenGL 3.3?");
+
+    // GLFW settings
+    glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    glfwSetCursorPos(gWindow, 0, 0);
+    glfwSetScrollCallback(gWindow, OnScroll);
+    glfwMakeContextCurrent(gWindow);
+
+    InitScene(options.scene);
+    gCamera.setViewportAspectRatio((float)options.width / (float)options.height);
+
+    // the flight can be recorded and played back in a headless run, see --path
+    core::CameraPath recordedPath;
+    const float recordInterval = 0.25f;
+    double recordStart = glfwGetTime();
+    double nextRecordTime = recordStart;
+
+    // the simulation runs in fixed steps, either here before each frame or on a thread of its own,
+    // and the frames blend the last two steps so the motion is smooth at any frame rate
+    const double simulationStep = 1.0 / options.simulationRate;
+    core::FixedTimestep timestep(simulationStep, MAX_SIMULATION_STEPS);
+    SimulationState previousSimulation = gSimulation;
+    std::unique_ptr<SimulationThread> simulationThread;
+    if (options.simulationThread)
+        simulationThread.reset(new SimulationThread(gSimulation, simulationStep));
+
+    // with --pipeline the next frame is updated while the current one renders, which shows the input
+    // one frame later. otherwise the update runs right before the frame that shows it
+    core::FramePipeline<FrameState> pipeline(options.pipeline);
+    pipeline.beginUpdate(UpdateJob([]() { ApplySimulation(gSimulation); }));
 
     // run while the window is open
     double lastTime = glfwGetTime();
+    double reportTime = lastTime;
+    unsigned framesSinceReport = 0;
     while (!glfwWindowShouldClose(gWindow)) {
-        // process pending events
-        glfwPollEvents();
+        gProfiler.beginFrame();
+        double thisTime;
+        {
+            core::Profiler::Scope profile(gProfiler, "Frame");
+
+            // the input changes the lights, which the update reads, so it waits for the update of the last frame
+            if (pipeline.threaded()) {
+                core::Profiler::Scope waitProfile(gProfiler, "WaitForUpdate");
+                pipeline.waitForUpdate();
+                pipeline.swap();
+            }
 
-        // update the scene based on the time elapsed since last update
-        double thisTime = glfwGetTime();
-        Update((float)(thisTime - lastTime));
-        lastTime = thisTime;
+            // process pending events
+            glfwPollEvents();
+            thisTime = glfwGetTime();
+            ProcessInput((float)(thisTime - lastTime));
+
+            // update the scene based on the time elapsed since last update
+            {
+                core::Profiler::Scope updateProfile(gProfiler, "Update");
+                if (simulationThread) {
+                    SimulationThread* thread = simulationThread.get();
+                    pipeline.beginUpdate(UpdateJob([thread]() { ApplySimulation(thread->sample()); }));
+                } else {
+                    int steps = timestep.advance(thisTime - lastTime);
+                    float alpha = timestep.alpha();
+                    pipeline.beginUpdate(UpdateJob([steps, alpha, simulationStep, &previousSimulation]() {
+                        for (int i = 0; i < steps; ++i) {
+                            previousSimulation = gSimulation;
+                            Simulate(gSimulation, (float)simulationStep);
+                        }
+                        ApplySimulation(InterpolateSimulation(previousSimulation, gSimulation, alpha));
+                    }));
+                }
+                if (!pipeline.threaded()) {
+                    pipeline.waitForUpdate();
+                    pipeline.swap();
+                }
+            }
+            lastTime = thisTime;
+
+            if (!options.recordPathFile.empty() && thisTime >= nextRecordTime) {
+                core::CameraPath::Keyframe keyframe;
+                keyframe.time = (float)(thisTime - recordStart);
+                keyframe.position = gCamera.position();
+                keyframe.target = gCamera.position() + gCamera.forward();
+                recordedPath.addKeyframe(keyframe);
+                nextRecordTime += recordInterval;
+            }
+
+            // draw one frame
+            Render(pipeline.front());
 
-        // draw one frame
-        Render();
+            // swap the display buffers (displays what was just drawn)
+            core::Profiler::Scope swapProfile(gProfiler, "SwapBuffers");
+            glfwSwapBuffers(gWindow);
+        }
+        gProfiler.endFrame();
+
+        // report the average frame time every two seconds, to compare the terrain mesh modes
+        ++framesSinceReport;
+        if (thisTime - reportTime >= 2.0) {
+            std::cout << "Frame time: " << 1000.0 * (thisTime - reportTime) / framesSinceReport << " ms, "
+                      << gTerrainTriangles << " terrain triangles, chunks visible/culled: "
+                      << gCullStats.visibleChunks << "/" << gCullStats.culledChunks << ", car batches visible/culled: "
+                      << gCullStats.visibleBatches << "/" << gCullStats.culledBatches << std::endl;
+            gProfiler.print(std::cout);
+            reportTime = thisTime;
+            framesSinceReport = 0;
+        }
 
         // check for errors
         GLenum error = glGetError();
@@ -1149,14 +2593,52 @@ void AppMain() {
             glfwSetWindowShouldClose(gWindow, GL_TRUE);
     }
 
+    if (!options.recordPathFile.empty()) {
+        recordedPath.saveToFile(options.recordPathFile);
+        std::cout << "Camera path: " << recordedPath.keyframeCount() << " keyframes written to " << options.recordPathFile << std::endl;
+    }
+
     // clean up and exit
+    pipeline.waitForUpdate();
+    simulationThread.reset();
+    gProfiler.deleteQueries();
     glfwTerminate();
 }
 
+// Here is the Main, the program starts here and initialize everything...
+void AppMain(const AppOptions& options) {
+    // the trace starts before anything is loaded, so slow startups show up too
+    core::Trace::setThreadName("main");
+    gTraceFile = options.traceFile;
+    core::Trace::setEnabled(!gTraceFile.empty());
+
+    core::JobSystem jobs;
+    gJobs = &jobs;
+    std::cout << "Job system: " << jobs.threadCount() << " threads" << std::endl;
+
+    if (options.bakeTextures)
+        BakeTextures();
+    else if (options.headless && options.renderer == "pathtrace")
+        RunPathTracer(options);
+    else if (options.headless)
+        RunHeadless(options);
+    else
+        RunWindowed(options);
+
+    // the idle time includes the frames, most of the jobs run while loading
+    core::JobSystem::Stats jobStats = jobs.stats();
+    std::cout << "Jobs: " << jobStats.jobs << " run, " << jobStats.steals << " stolen, "
+              << jobStats.idleSeconds << " s idle over all workers" << std::endl;
+    gJobs = NULL;
+
+    if (!gTraceFile.empty())
+        std::cout << "Trace: " << core::Trace::write(gTraceFile) << " events written to " << gTraceFile << std::endl;
+}
+
 
 int main(int argc, char* argv[]) {
     try {
-        AppMain();
+        AppMain(ParseOptions(argc, argv));
     }
     catch (const std::exception& e) {
         std::cerr << "ERROR: " << e.what() << std::endl;
@@ -1164,4 +2646,4 @@ int main(int argc, char* argv[]) {
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}